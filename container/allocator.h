@@ -33,11 +33,11 @@ struct allocator {
 
     [[nodiscard,__gnu__::__always_inline__]]
     constexpr static _Tp *calloc(size_t __n) {
-        static_assert(std::is_integral_v <_Tp>,
-            "Only integral types are allowed in calloc now.");
+        static_assert(std::is_trivial_v <_Tp>,
+            "Only trivial types are allowed in calloc now.");
         if (std::is_constant_evaluated()) {
             auto *__raw = std::allocator <_Tp> {}.allocate(__n);
-            for (size_t i = 0; i < __n; ++i) __raw[i] = 0;
+            for (size_t i = 0; i < __n; ++i) __raw[i] = _Tp {};
             return __raw;
         } else {
             return static_cast <_Tp *> (::std::calloc(__n, __N));
@@ -0,0 +1,205 @@
+#pragma once
+#include "bitset.h"
+#include <string_view>
+
+namespace dark {
+
+
+namespace __detail::__bit_match {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Size of the alphabet, one mask per byte. */
+inline constexpr size_t __Sigma = 256;
+
+/* Index of a character in the alphabet. */
+inline constexpr size_t index(char __c) { return static_cast <unsigned char> (__c); }
+
+/**
+ * Build per-character pattern masks, stored as __Sigma rows of __w words.
+ * Bit i of row c is set iff __pat[i] == c.
+ */
+inline constexpr dynamic_bitset make_masks(std::string_view __pat, size_t __w) {
+    dynamic_bitset __ret(__Sigma * __w * __WBits);
+    for (size_t i = 0 ; i != __pat.size() ; ++i)
+        __ret.set(index(__pat[i]) * __w * __WBits + i);
+    return __ret;
+}
+
+} // namespace __detail::__bit_match
+
+
+/**
+ * @brief Streaming Shift-And matcher with at most k mismatches.
+ * State j holds the pattern prefixes that match the text ending here
+ * with at most j substitutions (Baeza-Yates/Gonnet, Wu/Manber).
+ * Each character costs (k + 1) word operations per 64 pattern positions.
+ *
+ * Shift-Or is the same recurrence on the complemented states,
+ * so only the Shift-And form is kept here.
+ */
+struct shift_and_matcher {
+  private:
+    using _Word_t = __detail::__bit_match::_Word_t;
+
+    dynamic_bitset  masks;  // Pattern masks of each character
+    dynamic_bitset  state;  // (k + 1) rows of states
+    size_t          length; // Length of the pattern
+    size_t          words;  // Words per row
+    size_t          limit;  // Max mismatches allowed
+    size_t          offset; // Count of characters fed
+
+    constexpr _Word_t *row(size_t __j) { return state.data() + __j * words; }
+
+  public:
+    /* Create a matcher, allowing at most __k mismatches. */
+    constexpr explicit shift_and_matcher(std::string_view __pat, size_t __k = 0)
+        : length(__pat.size()),
+          words(__detail::__bitset::div_ceil(__pat.size())),
+          limit(__k), offset(0) {
+        if (__pat.empty())
+            throw std::invalid_argument("shift_and_matcher: empty pattern");
+        masks = __detail::__bit_match::make_masks(__pat, words);
+        state = dynamic_bitset((__k + 1) * words * __detail::__bit_match::__WBits);
+    }
+
+    /* Forget the text fed so far. */
+    constexpr void reset() { state.reset(); offset = 0; }
+
+    /* Count of characters fed so far. */
+    constexpr size_t position() const { return offset; }
+
+    /**
+     * @brief Feed the next chunk of text.
+     * For every position where the pattern ends with at most k mismatches,
+     * call __fn(pos, mismatches), where pos is the stream index of
+     * the last character of the match.
+     */
+    template <class _Fn>
+    constexpr void feed(std::string_view __text, _Fn &&__fn) {
+        using namespace __detail::__bit_match;
+        const auto [__div, __mod] = __detail::__bitset::div_mod(length - 1);
+
+        for (const char __c : __text) {
+            const auto *__b = masks.data() + index(__c) * words;
+
+            /**
+             * Words go from high to low, so the lower word is still old.
+             * Rows go from k to 0, so row j - 1 is still old when
+             * its shifted value is merged into row j.
+             */
+            for (size_t i = words ; i-- != 0 ;) {
+                for (size_t j = limit + 1 ; j-- != 0 ;) {
+                    auto *__row = row(j);
+                    const auto __low = i == 0 ? 1 : __row[i - 1] >> (__WBits - 1);
+                    const auto __sft = __row[i] << 1 | __low;
+                    __row[i] = __sft & __b[i];
+                    if (j != limit) row(j + 1)[i] |= __sft;
+                }
+            }
+
+            for (size_t j = 0 ; j <= limit ; ++j)
+                if ((row(j)[__div] >> __mod) & 1) { __fn(offset, j); break; }
+            ++offset;
+        }
+    }
+};
+
+
+/**
+ * @brief Streaming Myers matcher under Levenshtein distance.
+ * Uses the block-based bit-vector algorithm of Myers and Hyyrö:
+ * the vertical deltas of one DP column are kept as +1/-1 bit vectors,
+ * and the horizontal delta is carried from block to block.
+ * Each character costs a constant number of word operations
+ * per 64 pattern positions.
+ */
+struct myers_matcher {
+  private:
+    using _Word_t = __detail::__bit_match::_Word_t;
+
+    dynamic_bitset  masks;  // Pattern masks of each character
+    dynamic_bitset  vp;     // Vertical +1 deltas
+    dynamic_bitset  vn;     // Vertical -1 deltas
+    size_t          length; // Length of the pattern
+    size_t          words;  // Words per bit vector
+    size_t          limit;  // Max distance allowed
+    size_t          score;  // Distance of the whole pattern
+    size_t          offset; // Count of characters fed
+
+  public:
+    /* Create a matcher, reporting matches within distance __k. */
+    constexpr myers_matcher(std::string_view __pat, size_t __k)
+        : length(__pat.size()),
+          words(__detail::__bitset::div_ceil(__pat.size())),
+          limit(__k), score(__pat.size()), offset(0) {
+        if (__pat.empty())
+            throw std::invalid_argument("myers_matcher: empty pattern");
+        masks = __detail::__bit_match::make_masks(__pat, words);
+        this->reset();
+    }
+
+    /* Forget the text fed so far. */
+    constexpr void reset() {
+        vp.assign(words * __detail::__bit_match::__WBits, true);
+        vn.assign(words * __detail::__bit_match::__WBits, false);
+        score  = length;
+        offset = 0;
+    }
+
+    /* Count of characters fed so far. */
+    constexpr size_t position() const { return offset; }
+
+    /* Best distance of a match ending at the last character fed. */
+    constexpr size_t distance() const { return score; }
+
+    /**
+     * @brief Feed the next chunk of text.
+     * For every position where some substring ending there is within
+     * distance k of the pattern, call __fn(pos, distance), where pos
+     * is the stream index of the last character of the match.
+     */
+    template <class _Fn>
+    constexpr void feed(std::string_view __text, _Fn &&__fn) {
+        using namespace __detail::__bit_match;
+        const auto __top = (length - 1) % __WBits; // Last row in the last block.
+        auto *__vp = vp.data();
+        auto *__vn = vn.data();
+
+        for (const char __c : __text) {
+            const auto *__peq = masks.data() + index(__c) * words;
+            int __hin = 0; // Text may start anywhere, so row 0 is all 0.
+
+            for (size_t i = 0 ; i != words ; ++i) {
+                auto __eq = __peq[i];
+                const auto __pv = __vp[i];
+                const auto __mv = __vn[i];
+                const auto __xv = __eq | __mv;
+                if (__hin < 0) __eq |= 1;
+                const auto __xh = (((__eq & __pv) + __pv) ^ __pv) | __eq;
+                auto __ph = __mv | ~(__xh | __pv);
+                auto __mh = __pv & __xh;
+
+                const size_t __bit = i + 1 == words ? __top : __WBits - 1;
+                const int __hout = int((__ph >> __bit) & 1) - int((__mh >> __bit) & 1);
+
+                __ph <<= 1;
+                __mh <<= 1;
+                if (__hin < 0) __mh |= 1;
+                else if (__hin > 0) __ph |= 1;
+
+                __vp[i] = __mh | ~(__xv | __ph);
+                __vn[i] = __ph & __xv;
+                __hin = __hout;
+            }
+
+            score += __hin;
+            if (score <= limit) __fn(offset, score);
+            ++offset;
+        }
+    }
+};
+
+
+} // namespace dark
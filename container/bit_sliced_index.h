@@ -0,0 +1,312 @@
+#pragma once
+#include "bitset.h"
+#include <span>
+#include <cstdint>
+#include <optional>
+
+namespace dark {
+
+
+namespace __detail::__bit_sliced {
+
+using __bitset::_Word_t;
+
+/* Max bits of a value. */
+inline constexpr size_t __MaxBits = sizeof(std::uint64_t) * CHAR_BIT;
+
+/* Rows of one word compared with a constant. */
+struct compare_t { _Word_t lt, eq, gt; };
+
+} // namespace __detail::__bit_sliced
+
+
+/**
+ * @brief A bit-sliced index over an unsigned integer column.
+ * Bit i of every value is stored in slice i, and the existence
+ * bitmap marks the non-null rows. Predicates are evaluated with
+ * the O'Neil/Quass algorithms, one word (64 rows) at a time, so
+ * a predicate costs one word operation per 64 rows per slice.
+ *
+ * Every filter taken by the aggregates must have the same size
+ * as the index. Null rows never match any predicate.
+ */
+struct bit_sliced_index {
+  public:
+    using value_type = std::uint64_t;
+
+  private:
+    using _Word_t    = __detail::__bit_sliced::_Word_t;
+    using _Compare_t = __detail::__bit_sliced::compare_t;
+
+    size_t          width;  // Bits of each value
+    dynamic_bitset  exist;  // Existence bitmap
+    dynamic_bitset  slice[__detail::__bit_sliced::__MaxBits]; // Bit slices
+
+    /* Compare rows in the __w-th word with __c. */
+    constexpr _Compare_t compare(size_t __w, value_type __c) const {
+        _Word_t __eq = exist.data(__w), __lt = 0, __gt = 0;
+        if (width != __detail::__bit_sliced::__MaxBits && (__c >> width) != 0)
+            return { __eq, 0, 0 };
+        for (size_t i = width ; i-- != 0 ;) {
+            const auto __b = slice[i].data(__w);
+            if ((__c >> i) & 1) {
+                __lt |= __eq & ~__b;
+                __eq &= __b;
+            } else {
+                __gt |= __eq & __b;
+                __eq &= ~__b;
+            }
+        }
+        return { __lt, __eq, __gt };
+    }
+
+    /* Build a bitset of rows word by word. */
+    template <class _Fn>
+    constexpr dynamic_bitset build(_Fn &&__fn) const {
+        dynamic_bitset __ret(this->size());
+        const auto __size = exist.word_count();
+        for (size_t i = 0 ; i != __size ; ++i)
+            __ret.data(i) = __fn(i);
+        return __ret;
+    }
+
+    /* Count of 1s in (__x & __y) word by word. */
+    constexpr static size_t
+    count_and(const _Word_t *__x, const _Word_t *__y, size_t __n) {
+        size_t __cnt = 0;
+        for (size_t i = 0 ; i != __n ; ++i)
+            __cnt += std::popcount(__x[i] & __y[i]);
+        return __cnt;
+    }
+
+  public:
+    /* ctor section. */
+
+    /* Create an empty index of values with __bits bits. */
+    constexpr explicit bit_sliced_index(size_t __bits = __detail::__bit_sliced::__MaxBits)
+        : width(__bits) {
+        if (__bits > __detail::__bit_sliced::__MaxBits)
+            throw std::invalid_argument("bit_sliced_index: too many bits");
+    }
+
+    /* Build an index from a column of values. */
+    constexpr bit_sliced_index(std::span <const value_type> __col, size_t __bits)
+        : bit_sliced_index(__bits) {
+        for (const auto __val : __col) this->push_back(__val);
+    }
+
+  public:
+    /* Section of modifiers. */
+
+    /* Append a value. Bits beyond the width are ignored. */
+    constexpr void push_back(value_type __val) {
+        exist.push_back(true);
+        for (size_t i = 0 ; i != width ; ++i)
+            slice[i].push_back((__val >> i) & 1);
+    }
+
+    /* Append a null row. */
+    constexpr void push_back_null() {
+        exist.push_back(false);
+        for (size_t i = 0 ; i != width ; ++i)
+            slice[i].push_back(false);
+    }
+
+    /* Overwrite the value of a row, making it non-null. */
+    constexpr void set(size_t __row, value_type __val) {
+        exist.set(__row);
+        for (size_t i = 0 ; i != width ; ++i)
+            slice[i][__row] = (__val >> i) & 1;
+    }
+
+    /* Make a row null. */
+    constexpr void reset(size_t __row) {
+        exist.reset(__row);
+        for (size_t i = 0 ; i != width ; ++i)
+            slice[i].reset(__row);
+    }
+
+    constexpr void clear() {
+        exist.clear();
+        for (size_t i = 0 ; i != width ; ++i) slice[i].clear();
+    }
+
+  public:
+    /* Section of accessors. */
+
+    constexpr size_t size() const { return exist.size(); }
+    constexpr size_t bits() const { return width; }
+
+    /* Return whether a row is non-null. */
+    constexpr bool contains(size_t __row) const { return exist.test(__row); }
+
+    /* Value of a row, or nullopt if the row is null. */
+    constexpr std::optional <value_type> get(size_t __row) const {
+        if (!exist.test(__row)) return std::nullopt;
+        value_type __val = 0;
+        for (size_t i = 0 ; i != width ; ++i)
+            __val |= value_type(slice[i].test(__row)) << i;
+        return __val;
+    }
+
+    /* The existence bitmap. */
+    constexpr const dynamic_bitset &existence() const { return exist; }
+
+  public:
+    /* Section of predicates. */
+
+    /* Rows with x == __c. */
+    constexpr dynamic_bitset equal(value_type __c) const {
+        return this->build([&](size_t __w) { return this->compare(__w, __c).eq; });
+    }
+
+    /* Rows with x != __c. */
+    constexpr dynamic_bitset not_equal(value_type __c) const {
+        return this->build([&](size_t __w) {
+            const auto [__lt, __eq, __gt] = this->compare(__w, __c);
+            return __lt | __gt;
+        });
+    }
+
+    /* Rows with x < __c. */
+    constexpr dynamic_bitset less(value_type __c) const {
+        return this->build([&](size_t __w) { return this->compare(__w, __c).lt; });
+    }
+
+    /* Rows with x <= __c. */
+    constexpr dynamic_bitset less_equal(value_type __c) const {
+        return this->build([&](size_t __w) {
+            const auto [__lt, __eq, __gt] = this->compare(__w, __c);
+            return __lt | __eq;
+        });
+    }
+
+    /* Rows with x > __c. */
+    constexpr dynamic_bitset greater(value_type __c) const {
+        return this->build([&](size_t __w) { return this->compare(__w, __c).gt; });
+    }
+
+    /* Rows with x >= __c. */
+    constexpr dynamic_bitset greater_equal(value_type __c) const {
+        return this->build([&](size_t __w) {
+            const auto [__lt, __eq, __gt] = this->compare(__w, __c);
+            return __gt | __eq;
+        });
+    }
+
+    /* Rows with __lo <= x < __hi. */
+    constexpr dynamic_bitset between(value_type __lo, value_type __hi) const {
+        return this->build([&](size_t __w) {
+            return ~this->compare(__w, __lo).lt & this->compare(__w, __hi).lt;
+        });
+    }
+
+    /* Rows whose value is one of __set. */
+    constexpr dynamic_bitset in(std::span <const value_type> __set) const {
+        return this->build([&](size_t __w) {
+            _Word_t __ret = 0;
+            for (const auto __c : __set)
+                __ret |= this->compare(__w, __c).eq;
+            return __ret;
+        });
+    }
+
+  public:
+    /* Section of aggregates over a filter. */
+
+    /* Count of non-null rows in the filter. */
+    constexpr size_t count(const dynamic_bitset &__filter) const {
+        return count_and(exist.data(), __filter.data(), exist.word_count());
+    }
+
+    /* Sum of values in the filter, modulo 2^64. */
+    constexpr value_type sum(const dynamic_bitset &__filter) const {
+        const auto __size = exist.word_count();
+        value_type __ret = 0;
+        for (size_t i = 0 ; i != width ; ++i) {
+            /* Values in slice are valid only if the row exists. */
+            size_t __cnt = 0;
+            for (size_t j = 0 ; j != __size ; ++j)
+                __cnt += std::popcount(slice[i].data(j) & exist.data(j) & __filter.data(j));
+            __ret += value_type(__cnt) << i;
+        }
+        return __ret;
+    }
+
+    /* Max value in the filter, or nullopt if none. */
+    constexpr std::optional <value_type> max(const dynamic_bitset &__filter) const {
+        return this->extreme <true> (__filter);
+    }
+
+    /* Min value in the filter, or nullopt if none. */
+    constexpr std::optional <value_type> min(const dynamic_bitset &__filter) const {
+        return this->extreme <false> (__filter);
+    }
+
+    /**
+     * @brief Rows of the __k largest values in the filter.
+     * If there are ties at the boundary, rows with lower index win.
+     * If the filter has less than __k rows, all of them are returned.
+     */
+    constexpr dynamic_bitset top_k(const dynamic_bitset &__filter, size_t __k) const {
+        const auto __size = exist.word_count();
+        dynamic_bitset __g(this->size());   // Rows surely in the answer
+        dynamic_bitset __e = __filter;      // Rows still tied
+        __e &= exist;
+
+        size_t __cnt = 0; // Count of 1s in __g
+        for (size_t i = width ; i-- != 0 ;) {
+            const auto *__b = slice[i].data();
+            const size_t __add = count_and(__e.data(), __b, __size);
+            if (__cnt + __add > __k) { // Too many, the answer lies in them.
+                for (size_t j = 0 ; j != __size ; ++j)
+                    __e.data(j) &= __b[j];
+            } else { // All of them are in the answer.
+                for (size_t j = 0 ; j != __size ; ++j) {
+                    __g.data(j) |= __e.data(j) & __b[j];
+                    __e.data(j) &= ~__b[j];
+                }
+                if ((__cnt += __add) == __k) return __g;
+            }
+        }
+
+        /* Rows left in __e share the same value, take the first few. */
+        for (size_t j = 0 ; j != __size && __cnt != __k ; ++j) {
+            auto __w = __e.data(j);
+            while (__w != 0 && __cnt != __k) {
+                const auto __low = __w & -__w;
+                __g.data(j) |= __low;
+                __w ^= __low;
+                ++__cnt;
+            }
+        }
+        return __g;
+    }
+
+  private:
+    template <bool _Max>
+    constexpr std::optional <value_type> extreme(const dynamic_bitset &__filter) const {
+        const auto __size = exist.word_count();
+        dynamic_bitset __cand = __filter;
+        __cand &= exist;
+        if (__cand.none()) return std::nullopt;
+
+        value_type __ret = 0;
+        for (size_t i = width ; i-- != 0 ;) {
+            const auto *__b = slice[i].data();
+            /* Prefer rows whose i-th bit is 1 (max) or 0 (min). */
+            bool __any = false;
+            for (size_t j = 0 ; j != __size && !__any ; ++j)
+                __any = (__cand.data(j) & (_Max ? __b[j] : ~__b[j])) != 0;
+
+            if (__any == _Max) __ret |= value_type(1) << i;
+            if (!__any) continue;
+            for (size_t j = 0 ; j != __size ; ++j)
+                __cand.data(j) &= _Max ? __b[j] : ~__b[j];
+        }
+        return __ret;
+    }
+};
+
+
+} // namespace dark
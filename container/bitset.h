@@ -1,56 +1,194 @@
 #pragma once
 #include <bit>
+#include <cstdint>
 #include <cstring>
 #include <climits>
 #include <cstdlib>
+#include <concepts>
 #include <stdexcept>
 #include "allocator.h"
 
 namespace dark {
 
 
-struct dynamic_bitset;
+template <class _Word>
+struct basic_dynamic_bitset;
 
 
 namespace __detail::__bitset {
 
-/* Word used in bitset. */
+/* Default word used in bitset. */
 using _Word_t = size_t;
 
-/* Word bits. */
-inline constexpr size_t __WBits = sizeof(_Word_t) * CHAR_BIT;
+/**
+ * A vector block of _Lanes 64-bit lanes, lane 0 holding the lowest bits.
+ * Each operation is a fixed-size loop over the lanes, which the compiler
+ * turns into a few SSE/AVX2/AVX-512 instructions as the target allows.
+ * Shifts carry bits across the lanes, as on one wide integer.
+ */
+template <size_t _Lanes>
+struct wide_word {
+    std::uint64_t lane[_Lanes];
+
+    constexpr wide_word &operator &= (const wide_word &__rhs) {
+#pragma GCC unroll 8
+        for (size_t i = 0 ; i != _Lanes ; ++i) lane[i] &= __rhs.lane[i];
+        return *this;
+    }
+
+    constexpr wide_word &operator |= (const wide_word &__rhs) {
+#pragma GCC unroll 8
+        for (size_t i = 0 ; i != _Lanes ; ++i) lane[i] |= __rhs.lane[i];
+        return *this;
+    }
+
+    constexpr wide_word &operator ^= (const wide_word &__rhs) {
+#pragma GCC unroll 8
+        for (size_t i = 0 ; i != _Lanes ; ++i) lane[i] ^= __rhs.lane[i];
+        return *this;
+    }
+
+    constexpr wide_word operator ~ () const {
+        wide_word __ret;
+#pragma GCC unroll 8
+        for (size_t i = 0 ; i != _Lanes ; ++i) __ret.lane[i] = ~lane[i];
+        return __ret;
+    }
+
+    /* Shift towards the high bits, where __n < 64 * _Lanes. */
+    constexpr wide_word operator << (size_t __n) const {
+        const auto __div = __n / 64, __mod = __n % 64;
+        wide_word __ret {};
+#pragma GCC unroll 8
+        for (size_t i = __div ; i < _Lanes ; ++i) {
+            __ret.lane[i] = lane[i - __div] << __mod;
+            if (__mod != 0 && i != __div)
+                __ret.lane[i] |= lane[i - __div - 1] >> (64 - __mod);
+        }
+        return __ret;
+    }
+
+    /* Shift towards the low bits, where __n < 64 * _Lanes. */
+    constexpr wide_word operator >> (size_t __n) const {
+        const auto __div = __n / 64, __mod = __n % 64;
+        wide_word __ret {};
+#pragma GCC unroll 8
+        for (size_t i = 0 ; i + __div < _Lanes ; ++i) {
+            __ret.lane[i] = lane[i + __div] >> __mod;
+            if (__mod != 0 && i + __div + 1 != _Lanes)
+                __ret.lane[i] |= lane[i + __div + 1] << (64 - __mod);
+        }
+        return __ret;
+    }
+
+    friend constexpr wide_word operator & (wide_word __lhs, const wide_word &__rhs) { return __lhs &= __rhs; }
+    friend constexpr wide_word operator | (wide_word __lhs, const wide_word &__rhs) { return __lhs |= __rhs; }
+    friend constexpr wide_word operator ^ (wide_word __lhs, const wide_word &__rhs) { return __lhs ^= __rhs; }
+
+    friend constexpr bool operator == (const wide_word &, const wide_word &) = default;
+};
+
+/**
+ * Traits of a word type, giving the masks and bit counts that
+ * the kernels need. Any unsigned integer is a word, and so is
+ * wide_word, which specializes the traits below.
+ */
+template <class _Word>
+struct word_traits {
+    static_assert(std::unsigned_integral <_Word> && !std::same_as <_Word, bool>,
+        "The word of bitset must be an unsigned integer or a wide_word.");
+
+    inline static constexpr size_t bits = sizeof(_Word) * CHAR_BIT;
+
+    static constexpr _Word ones() { return static_cast <_Word> (~_Word{0}); }
+    static constexpr _Word mask_pos(size_t __n) { return static_cast <_Word> (_Word{1} << __n); }
+    static constexpr _Word mask_low(size_t __n) { return static_cast <_Word> ((_Word{1} << __n) - 1); }
+    static constexpr _Word mask_top(size_t __n) { return static_cast <_Word> (ones() << __n); }
+
+    static constexpr size_t popcount(_Word __w) { return std::popcount(__w); }
+    static constexpr bool test(_Word __w, size_t __n) { return (__w >> __n) & 1; }
+};
+
+template <size_t _Lanes>
+struct word_traits <wide_word <_Lanes>> {
+    using _Wide_t = wide_word <_Lanes>;
+
+    inline static constexpr size_t bits = 64 * _Lanes;
+
+    static constexpr _Wide_t ones() { return ~_Wide_t {}; }
+
+    static constexpr _Wide_t mask_pos(size_t __n) {
+        _Wide_t __ret {};
+        __ret.lane[__n / 64] = std::uint64_t{1} << (__n % 64);
+        return __ret;
+    }
+
+    static constexpr _Wide_t mask_low(size_t __n) {
+        _Wide_t __ret {};
+        for (size_t i = 0 ; i != __n / 64 ; ++i) __ret.lane[i] = ~std::uint64_t{0};
+        __ret.lane[__n / 64] = (std::uint64_t{1} << (__n % 64)) - 1;
+        return __ret;
+    }
+
+    static constexpr _Wide_t mask_top(size_t __n) { return ~mask_low(__n); }
+
+    static constexpr size_t popcount(const _Wide_t &__w) {
+        size_t __cnt = 0;
+#pragma GCC unroll 8
+        for (size_t i = 0 ; i != _Lanes ; ++i) __cnt += std::popcount(__w.lane[i]);
+        return __cnt;
+    }
+
+    static constexpr bool test(const _Wide_t &__w, size_t __n) {
+        return (__w.lane[__n / 64] >> (__n % 64)) & 1;
+    }
+};
+
+/* Bits of a word. */
+template <class _Word>
+inline constexpr size_t word_bits = word_traits <_Word>::bits;
+
+/* Bits of the default word. */
+inline constexpr size_t __WBits = word_bits <_Word_t>;
 
 /* Set __n-th bit to 1.  */
-inline constexpr _Word_t
-mask_pos(size_t __n) { return _Word_t{1} << __n; }
+template <class _Word = _Word_t>
+inline constexpr _Word
+mask_pos(size_t __n) { return word_traits <_Word>::mask_pos(__n); }
 
 /* Set first n low bits to 1, others to 0. */
-inline constexpr _Word_t
-mask_low(size_t __n) { return (_Word_t{1} << __n) - 1; }
+template <class _Word = _Word_t>
+inline constexpr _Word
+mask_low(size_t __n) { return word_traits <_Word>::mask_low(__n); }
 
 /* Set first n low bits to 0, others to 1. */
-inline constexpr _Word_t
-mask_top(size_t __n) { return (~_Word_t{0}) << __n; }
+template <class _Word = _Word_t>
+inline constexpr _Word
+mask_top(size_t __n) { return word_traits <_Word>::mask_top(__n); }
 
 /* Allocate a sequence of zero memory. */
-inline constexpr _Word_t *
-alloc_zero(size_t __n) { return allocator<_Word_t>::calloc(__n); }
+template <class _Word = _Word_t>
+inline constexpr _Word *
+alloc_zero(size_t __n) { return allocator<_Word>::calloc(__n); }
 
 /* Allocate a sequence of raw memory. */
-inline constexpr _Word_t *
-alloc_none(size_t __n) { return allocator<_Word_t>::allocate(__n); }
+template <class _Word = _Word_t>
+inline constexpr _Word *
+alloc_none(size_t __n) { return allocator<_Word>::allocate(__n); }
 
 /* Deallocate memory. */
-inline constexpr void deallocate(_Word_t *__ptr, size_t __n)
-{ allocator<_Word_t>::deallocate(__ptr, __n); }
+template <class _Word>
+inline constexpr void deallocate(_Word *__ptr, size_t __n)
+{ allocator<_Word>::deallocate(__ptr, __n); }
 
 /* Copy __n words from __src to __dst (memcpy/memmove). */
-template <bool _Move = false>
+template <bool _Move = false, class _Word>
 inline constexpr void
-word_copy(_Word_t *__dst, const _Word_t *__src, size_t __n) {
+word_copy(_Word *__dst, const _Word *__src, size_t __n) {
     if (std::is_constant_evaluated()) {
         if (__src == __dst) return; // No need to copy.
-        if (__dst < __src + __n && __src < __dst) {
+        /* Only memmove may overlap, and only then are pointers comparable. */
+        if (_Move && __dst < __src + __n && __src < __dst) {
             // Overlapping, copy from the end.
             __dst += __n; __src += __n;
             for (size_t i = 0 ; i != __n ; ++i)
@@ -60,7 +198,7 @@ word_copy(_Word_t *__dst, const _Word_t *__src, size_t __n) {
                 __dst[i] = __src[i];
         }
     } else { // Non-constant evaluated.
-        const size_t __size = __n * sizeof(_Word_t);
+        const size_t __size = __n * sizeof(_Word);
         if constexpr (_Move) {
             std::memmove(__dst, __src, __size);
         } else {
@@ -70,74 +208,78 @@ word_copy(_Word_t *__dst, const _Word_t *__src, size_t __n) {
 }
 
 /* Move __n words from __src to __dst using memmove. */
+template <class _Word>
 inline constexpr void
-word_move(_Word_t *__dst, const _Word_t *__src, size_t __n) {
-    if (std::is_constant_evaluated()) {
-        if (__dst <= __src && __dst + __n > __src)
-            for (size_t i = __n - 1 ; i >= 0 ; --i)
-                __dst[i] = __src[i];
-    } else {
-        std::memmove(__dst, __src, __n * sizeof(_Word_t));
-    }
+word_move(_Word *__dst, const _Word *__src, size_t __n) {
+    return word_copy <true> (__dst, __src, __n);
 }
 
 /* Reset __n words to given 0 or 1. */
+template <class _Word>
 inline constexpr void
-word_reset(_Word_t *__dst, bool __val, size_t __n) {
+word_reset(_Word *__dst, bool __val, size_t __n) {
     if (std::is_constant_evaluated()) {
         for (size_t i = 0 ; i != __n ; ++i)
-            __dst[i] = -_Word_t(__val);
+            __dst[i] = __val ? word_traits <_Word>::ones() : _Word {};
     } else {
-        std::memset(__dst, -__val, __n * sizeof(_Word_t));
+        std::memset(__dst, -__val, __n * sizeof(_Word));
     }
 }
 
 
 /* Return the quotient and remainder of __n , 64 */
-inline constexpr auto div_mod(_Word_t __n) {
+template <class _Word = _Word_t>
+inline constexpr auto div_mod(size_t __n) {
+    constexpr size_t __Bits = word_bits <_Word>;
     struct {
-        _Word_t div;
-        _Word_t mod;
-    } __ret = {__n / __WBits, __n % __WBits};
+        size_t div;
+        size_t mod;
+    } __ret = {__n / __Bits, __n % __Bits};
     return __ret;
 }
 
 /* Return ceiling of __n / 64 */
-inline constexpr _Word_t div_ceil(_Word_t __n) {
-    return (__n + __WBits - 1) / __WBits;
+template <class _Word = _Word_t>
+inline constexpr size_t div_ceil(size_t __n) {
+    return (__n + word_bits <_Word> - 1) / word_bits <_Word>;
 }
 
 /* Return ceiling of __n / 64 - 1, last available word. */
-inline constexpr _Word_t div_down(_Word_t __n) {
-    return (__n - 1) / __WBits;
+template <class _Word = _Word_t>
+inline constexpr size_t div_down(size_t __n) {
+    return (__n - 1) / word_bits <_Word>;
 }
 
 /* Return 64 - __n, where __n is less than 64 */
-inline constexpr _Word_t rev_bits(_Word_t __n) {
-    return ((__WBits - 1) ^ __n) + 1;
+template <class _Word = _Word_t>
+inline constexpr size_t rev_bits(size_t __n) {
+    return ((word_bits <_Word> - 1) ^ __n) + 1;
 }
 
 /* Make the last word valid. */
-inline constexpr void validate(_Word_t *__dst, size_t __n) {
-    const auto [__div, __mod] = div_mod(__n);
-    if (__mod != 0) __dst[__div] &= mask_low(__mod);
+template <class _Word>
+inline constexpr void validate(_Word *__dst, size_t __n) {
+    const auto [__div, __mod] = div_mod <_Word> (__n);
+    if (__mod != 0) __dst[__div] &= mask_low <_Word> (__mod);
 }
 
 /* Custom bit manipulator. */
+template <class _Word = _Word_t>
 struct reference {
   private:
-    _Word_t *   ptr;        // Pointer to the word
-    size_t msk;        // Mask word of the bit
+    _Word *     ptr;    // Pointer to the word
+    _Word       msk;    // Mask word of the bit
 
-    friend class ::dark::dynamic_bitset;
+    template <class>
+    friend struct ::dark::basic_dynamic_bitset;
 
     /* ctor */
-    constexpr reference(_Word_t *__ptr, size_t __pos)
-    noexcept : ptr(__ptr), msk(mask_pos(__pos)) {}
+    constexpr reference(_Word *__ptr, size_t __pos)
+    noexcept : ptr(__ptr), msk(mask_pos <_Word> (__pos)) {}
 
   public:
     /* Convert to bool. */
-    constexpr operator bool() const { return *ptr & msk; }
+    constexpr operator bool() const { return (*ptr & msk) != _Word {}; }
 
     /* Set current bit to 1. */
     constexpr void set()    { *ptr |= msk; }
@@ -155,22 +297,23 @@ struct reference {
 };
 
 /* Custom bit vector. */
+template <class _Word = _Word_t>
 struct dynamic_storage {
   private:
-    _Word_t *   head;   // Pointer to the first word
+    _Word *     head;   // Pointer to the first word
     size_t buffer; // Buffer size
   protected:
     size_t length; // Real length of the bitset
 
     /* Reallocate memory. */
     constexpr void
-    realloc(size_t __n) { head = alloc_none(buffer = __n); }
+    realloc(size_t __n) { head = alloc_none <_Word> (buffer = __n); }
 
     /* Deallocate memory. */
     constexpr void dealloc() { deallocate(head, buffer); }
 
     /* Deallocate memory. */
-    constexpr static void dealloc(_Word_t *__ptr, size_t __n) {
+    constexpr static void dealloc(_Word *__ptr, size_t __n) {
         deallocate(__ptr, __n);
     }
 
@@ -184,11 +327,11 @@ struct dynamic_storage {
     constexpr dynamic_storage()   noexcept { this->reset();   }
 
     constexpr dynamic_storage(size_t __n) {
-        head = alloc_none(buffer = div_ceil(length = __n));
+        head = alloc_none <_Word> (buffer = div_ceil <_Word> (length = __n));
     }
 
     constexpr dynamic_storage(size_t __n, std::nullptr_t) {
-        head = alloc_zero(buffer = div_ceil(length = __n));
+        head = alloc_zero <_Word> (buffer = div_ceil <_Word> (length = __n));
     }
 
     constexpr dynamic_storage(const dynamic_storage &rhs)
@@ -207,9 +350,9 @@ struct dynamic_storage {
         if (this == &rhs) return *this;
         if (this->capacity() < rhs.word_count()){
             this->dealloc();
-            this->realloc(rhs.length);
-            length = rhs.length;
+            this->realloc(rhs.word_count());
         }
+        length = rhs.length;
         word_copy(head, rhs.head, rhs.word_count());
         return *this;
     }
@@ -221,7 +364,7 @@ struct dynamic_storage {
     /* Function section. */
 
     /* Return the real word in the bitmap */
-    constexpr size_t word_count() const { return div_ceil(length); }
+    constexpr size_t word_count() const { return div_ceil <_Word> (length); }
     /* Return the capacity of the storage. */
     constexpr size_t capacity()   const { return buffer; }
 
@@ -232,13 +375,14 @@ struct dynamic_storage {
         return *this;
     }
 
-    constexpr _Word_t *data() const { return head; }
-    constexpr _Word_t  data(size_t __n) const { return head[__n]; }
-    constexpr _Word_t &data(size_t __n)       { return head[__n]; }
+    constexpr _Word *data() { return head; }
+    constexpr const _Word *data() const { return head; }
+    constexpr const _Word &data(size_t __n) const { return head[__n]; }
+    constexpr _Word &data(size_t __n)       { return head[__n]; }
 
     /* Grow the size by one, and fill with given value in the back. */
     constexpr void grow_full(bool __val) {
-        const auto __size = length / __WBits;
+        const auto __size = length / word_bits <_Word>;
         const auto __capa = this->capacity();
         if (__size == __capa) {
             auto *__temp = head;
@@ -246,7 +390,17 @@ struct dynamic_storage {
             word_copy(head, __temp, __capa);
             this->dealloc(__temp, __capa);
         }
-        data(__size) = __val;
+        data(__size) = __val ? mask_pos <_Word> (0) : _Word {};
+    }
+
+    /* Ensure the capacity of __n words, keeping the words in use. */
+    constexpr void reserve(size_t __n) {
+        const auto __capa = this->capacity();
+        if (__n <= __capa) return;
+        auto *__temp = head;
+        this->realloc(__n < (__capa << 1) ? (__capa << 1) : __n);
+        word_copy(head, __temp, this->word_count());
+        this->dealloc(__temp, __capa);
     }
 
     /* Pop one element. */
@@ -258,133 +412,146 @@ struct dynamic_storage {
     constexpr void clear() noexcept { length = 0; }
 };
 
+template <class _Word>
 inline constexpr void
-do_and(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
-    const auto [__div, __mod] = div_mod(__n);
+do_and(_Word *__dst, const _Word *__rhs, size_t __n) {
+    const auto [__div, __mod] = div_mod <_Word> (__n);
     for (size_t i = 0; i != __div; ++i)
         __dst[i] &= __rhs[i];
     if (__mod != 0)
-        __dst[__div] &= __rhs[__div] | mask_top(__mod);
+        __dst[__div] &= __rhs[__div] | mask_top <_Word> (__mod);
 }
 
+template <class _Word>
 inline constexpr void
-do_or_(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
-    const auto [__div, __mod] = div_mod(__n);
+do_or_(_Word *__dst, const _Word *__rhs, size_t __n) {
+    const auto [__div, __mod] = div_mod <_Word> (__n);
     for (size_t i = 0; i != __div; ++i)
         __dst[i] |= __rhs[i];
     if (__mod != 0)
-        __dst[__div] |= __rhs[__div] & mask_low(__mod);
+        __dst[__div] |= __rhs[__div] & mask_low <_Word> (__mod);
 }
 
+template <class _Word>
 inline constexpr void
-do_xor(_Word_t *__dst, const _Word_t *__rhs, size_t __n) {
-    const auto [__div, __mod] = div_mod(__n);
+do_xor(_Word *__dst, const _Word *__rhs, size_t __n) {
+    const auto [__div, __mod] = div_mod <_Word> (__n);
     for (size_t i = 0; i != __div; ++i)
         __dst[i] ^= __rhs[i];
     if (__mod != 0)
-        __dst[__div] ^= __rhs[__div] & mask_low(__mod);
+        __dst[__div] ^= __rhs[__div] & mask_low <_Word> (__mod);
 }
 
 static_assert(std::endian::native == std::endian::little,
     "Our implement only supports little endian now.");
 
 /* 2-pointer small struct. */
-struct vec2 { _Word_t *dst; const _Word_t *src; };
-
-inline static constexpr vec2
-operator << (vec2 __vec, size_t __n) { return {__vec.dst, __vec.src - __n}; }
-inline static constexpr vec2
-operator >> (vec2 __vec, size_t __n) { return {__vec.dst, __vec.src + __n}; }
-inline static constexpr vec2
-operator + (vec2 __vec, size_t __n) { return {__vec.dst + __n, __vec.src + __n}; }
+template <class _Word>
+struct vec2 { _Word *dst; const _Word *src; };
+
+template <class _Word>
+inline static constexpr vec2 <_Word>
+operator << (vec2 <_Word> __vec, size_t __n) { return {__vec.dst, __vec.src - __n}; }
+template <class _Word>
+inline static constexpr vec2 <_Word>
+operator >> (vec2 <_Word> __vec, size_t __n) { return {__vec.dst, __vec.src + __n}; }
+template <class _Word>
+inline static constexpr vec2 <_Word>
+operator + (vec2 <_Word> __vec, size_t __n) { return {__vec.dst + __n, __vec.src + __n}; }
 
 /* Lshift word by word (with memmove) */
+template <class _Word>
 inline constexpr void
-word_lshift(vec2 __vec, size_t __n, size_t __shift) {
+word_lshift(vec2 <_Word> __vec, size_t __n, size_t __shift) {
     if (__shift == 0) return;
     const auto [__dst, __src] = __vec;
-    const auto __offset = __shift / __WBits;
-    const auto __count  = div_ceil(__n) - __offset;
+    const auto __offset = __shift / word_bits <_Word>;
+    const auto __count  = div_ceil <_Word> (__n) - __offset;
     word_copy<true>(__dst + __offset, __src, __count);
     return word_reset(__dst, 0, __offset);
 }
 
 /* Rshift word by word. */
+template <class _Word>
 inline constexpr void
-word_rshift(vec2 __vec, size_t __n, size_t __shift) {
+word_rshift(vec2 <_Word> __vec, size_t __n, size_t __shift) {
     if (__shift == 0) return;
     const auto [__dst, __src] = __vec;
-    const auto __offset = __shift / __WBits;
-    const auto __count  = div_ceil(__n) - __offset;
+    const auto __offset = __shift / word_bits <_Word>;
+    const auto __count  = div_ceil <_Word> (__n); // __n is the length after shift.
     return word_copy<true>(__dst, __src + __offset, __count);
 }
 
 /* Lshift bits by bits. */
+template <class _Word>
 inline constexpr void
-bits_lshift(vec2 __vec, size_t __n, size_t __shift) {
-    const auto [__div, __mod] = div_mod(__shift);
+bits_lshift(vec2 <_Word> __vec, size_t __n, size_t __shift) {
+    const auto [__div, __mod] = div_mod <_Word> (__shift);
 
-    const auto __len = div_down(__n);
-    const auto __rev = rev_bits(__mod); // 64 - __mod
+    const auto __len = div_down <_Word> (__n);
+    const auto __rev = rev_bits <_Word> (__mod); // 64 - __mod
     const auto __end = __vec.src;
 
     auto [__dst, __src] = (__vec + __len) << __div;
 
     /* The last word may be unsafe. */
-    auto __pre = div_down(__n - __mod) == __len ? *__src : 0;
+    _Word __pre = div_down <_Word> (__n - __mod) == __len ? *__src : _Word {};
 
     while (__src != __end) {
-        auto __cur = *--__src;
-        *__dst-- = __pre << __mod | __cur >> __rev;
+        _Word __cur = *--__src;
+        *__dst-- = static_cast <_Word> (__pre << __mod | __cur >> __rev);
         __pre = __cur; // Update the previous word.
     }
 
     /* The first word must be safe. */
-    *__dst = __pre << __mod;
+    *__dst = static_cast <_Word> (__pre << __mod);
 
     /* Validate those words in the front. */
     return word_reset(__dst - __div, 0, __div);
 }
 
-/* Lshift bits by bits. */
+/* Rshift bits by bits. */
+template <class _Word>
 inline constexpr void
-bits_rshift(vec2 __vec, size_t __n, size_t __shift) {
-    const auto [__div, __mod] = div_mod(__shift);
+bits_rshift(vec2 <_Word> __vec, size_t __n, size_t __shift) {
+    const auto [__div, __mod] = div_mod <_Word> (__shift);
 
-    const auto __len = div_down(__n);
-    const auto __rev = rev_bits(__mod); // 64 - __mod
+    const auto __len = div_down <_Word> (__n);
+    const auto __rev = rev_bits <_Word> (__mod); // 64 - __mod
     const auto __end = __vec.dst + __len;
 
     auto [__dst, __src] = __vec >> __div;
     /* The first word must be safe. */
-    auto __pre = *__src;
+    _Word __pre = *__src;
 
     while (__dst != __end) {
-        auto __cur = *++__src;
-        *__dst++ = __pre >> __mod | __cur << __rev;
+        _Word __cur = *++__src;
+        *__dst++ = static_cast <_Word> (__pre >> __mod | __cur << __rev);
         __pre = __cur; // Update the previous word.
     }
 
     /* The last word may be unsafe. */
-    auto __cur = div_down(__n + __mod) == __len ? 0 : *++__src;
+    _Word __cur = div_down <_Word> (__n + __mod) == __len ? _Word {} : *++__src;
 
     /* Rely on the fact that the unused bit of src is filled with 0. */
-    *__dst = __pre >> __mod | __cur << __rev;
+    *__dst = static_cast <_Word> (__pre >> __mod | __cur << __rev);
 }
 
 /* Perform left shift operation without any validation. */
+template <class _Word>
 inline constexpr void
-do_lshift(vec2 __vec, size_t __n, size_t __shift) {
-    if (__shift % __WBits != 0)
+do_lshift(vec2 <_Word> __vec, size_t __n, size_t __shift) {
+    if (__shift % word_bits <_Word> != 0)
         return bits_lshift(__vec, __n, __shift);
     else // __shift % CHAR_BIT == 0. Align to byte.
         return word_lshift(__vec, __n, __shift);
 }
 
 /* Perform right shift operation with natural validation. */
+template <class _Word>
 inline constexpr void
-do_rshift(vec2 __vec, size_t __n, size_t __shift) {
-    if (__shift % __WBits != 0)
+do_rshift(vec2 <_Word> __vec, size_t __n, size_t __shift) {
+    if (__shift % word_bits <_Word> != 0)
         return bits_rshift(__vec, __n, __shift);
     else // __shift % CHAR_BIT == 0. Align to byte.
         return word_rshift(__vec, __n, __shift);
@@ -394,38 +561,49 @@ do_rshift(vec2 __vec, size_t __n, size_t __shift) {
 } // namespace __detail::__bitset
 
 
-struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
+/**
+ * @brief A dynamic bitset whose words are _Word.
+ * _Word is an unsigned integer, or a wide_block for vector blocks.
+ * Every kernel is instantiated for the word, so the choice costs
+ * nothing at runtime: narrow words save memory on small sets, and
+ * wide blocks give long straight loops for SIMD.
+ */
+template <class _Word = __detail::__bitset::_Word_t>
+struct basic_dynamic_bitset : private __detail::__bitset::dynamic_storage <_Word> {
   public:
-    using _Bitset   = dynamic_bitset;
-    using reference = __detail::__bitset::reference;
+    using _Bitset   = basic_dynamic_bitset;
+    using reference = __detail::__bitset::reference <_Word>;
+    using word_type = _Word;
 
     inline static constexpr size_t npos = -1;
 
   private:
-    using _Base_t = __detail::__bitset::dynamic_storage;
-    using _Word_t = __detail::__bitset::_Word_t;
+    using _Base_t   = __detail::__bitset::dynamic_storage <_Word>;
+    using _Word_t   = _Word;
+    using _Traits_t = __detail::__bitset::word_traits <_Word>;
+    using _Base_t::length;
 
-    constexpr static _Word_t min(_Word_t __x, _Word_t __y) { return __x < __y ? __x : __y; }
+    constexpr static size_t min(size_t __x, size_t __y) { return __x < __y ? __x : __y; }
   public:
     /* ctor and operator section. */
 
-    constexpr dynamic_bitset() = default;
-    constexpr ~dynamic_bitset() = default;
+    constexpr basic_dynamic_bitset() = default;
+    constexpr ~basic_dynamic_bitset() = default;
 
-    constexpr dynamic_bitset(const dynamic_bitset &) = default;
-    constexpr dynamic_bitset(dynamic_bitset &&) noexcept = default;
+    constexpr basic_dynamic_bitset(const basic_dynamic_bitset &) = default;
+    constexpr basic_dynamic_bitset(basic_dynamic_bitset &&) noexcept = default;
 
-    constexpr dynamic_bitset &operator = (const dynamic_bitset &) = default;
-    constexpr dynamic_bitset &operator = (dynamic_bitset &&) noexcept = default;
+    constexpr basic_dynamic_bitset &operator = (const basic_dynamic_bitset &) = default;
+    constexpr basic_dynamic_bitset &operator = (basic_dynamic_bitset &&) noexcept = default;
 
-    constexpr dynamic_bitset(size_t __n) : _Base_t(__n, nullptr) {}
+    constexpr basic_dynamic_bitset(size_t __n) : _Base_t(__n, nullptr) {}
 
-    constexpr dynamic_bitset(size_t __n, bool __x) : _Base_t(__n) {
+    constexpr basic_dynamic_bitset(size_t __n, bool __x) : _Base_t(__n) {
         __detail::__bitset::word_reset(this->data(), __x, this->word_count());
         if (__x) __detail::__bitset::validate(this->data(), length);
     }
 
-    constexpr dynamic_bitset(std::string_view __str) : dynamic_bitset(__str.size()) {
+    constexpr basic_dynamic_bitset(std::string_view __str) : basic_dynamic_bitset(__str.size()) {
         length = __str.size();
         for (size_t i = 0 ; i != length ; ++i)
             if (__str[i] == '1') this->set(i);
@@ -462,7 +640,7 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
         if (__capa < __size) this->realloc(__size + __capa);
 
         const auto __data = this->data();
-        __detail::__bitset::do_lshift({__data, __head}, length, __n);
+        __detail::__bitset::do_lshift <_Word> ({__data, __head}, length, __n);
         __detail::__bitset::validate(__data, length);
 
         /* If realloc, deallocate the old memory. */
@@ -474,7 +652,7 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
         if (__n < length) {
             length -= __n;
             const auto __data = this->data();
-            __detail::__bitset::do_rshift({__data, __data}, length, __n);
+            __detail::__bitset::do_rshift <_Word> ({__data, __data}, length, __n);
         } else this->clear();
         return *this;
     }
@@ -494,7 +672,7 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
     constexpr _Bitset &flip() {
         const auto __size = this->word_count();
         for (size_t i = 0 ; i != __size ; ++i)
-            this->data(i) = ~this->data(i);
+            this->data(i) = static_cast <_Word> (~this->data(i));
         __detail::__bitset::validate(this->data(), length);
         return *this;
     }
@@ -509,16 +687,16 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
     constexpr bool any() const { return !this->none(); }
     /* Return whether all bits are set to 1. */
     constexpr bool all() const {
-        auto [__div, __mod] = __detail::__bitset::div_mod(length);
+        auto [__div, __mod] = __detail::__bitset::div_mod <_Word> (length);
         for (size_t i = 0 ; i != __div ; ++i)
-            if (~data(i) != 0) return false;
-        return data(__div) == __detail::__bitset::mask_low(__mod);
+            if (data(i) != _Traits_t::ones()) return false;
+        return __mod == 0 || data(__div) == __detail::__bitset::mask_low <_Word> (__mod);
     }
     /* Return whether all bits are set to 0. */
     constexpr bool none() const {
         auto __top = this->word_count();
         for (size_t i = 0 ; i != __top ; ++i)
-            if (data(i) != 0) return false;
+            if (data(i) != _Word {}) return false;
         return true;
     }
 
@@ -527,7 +705,7 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
         size_t __cnt = 0;
         auto __top = this->word_count();
         for (size_t i = 0 ; i != __top ; ++i)
-            __cnt += std::popcount(data(i));
+            __cnt += _Traits_t::popcount(data(i));
         return __cnt;
     }
 
@@ -536,14 +714,14 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
     constexpr void flip(size_t __n)      { (*this)[__n].flip();    }
 
     constexpr bool test(size_t __n) const {
-        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
-        return (data(__div) >> __mod) & 1;
+        auto [__div, __mod] = __detail::__bitset::div_mod <_Word> (__n);
+        return _Traits_t::test(data(__div), __mod);
     }
 
     constexpr size_t size()  const { return length; }
 
     constexpr reference operator [] (size_t __n) {
-        auto [__div, __mod] = __detail::__bitset::div_mod(__n);
+        auto [__div, __mod] = __detail::__bitset::div_mod <_Word> (__n);
         return reference(data() + __div, __mod);
     }
     constexpr reference at(size_t __n) { this->range_check(__n); return (*this)[__n]; }
@@ -558,13 +736,19 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
     constexpr size_t find_first();
     constexpr size_t find_next(size_t);
 
+  public:
+    /* Section of raw word access, unused bits in the last word are 0. */
+
+    using _Base_t::data;
+    using _Base_t::word_count;
+
   public:
     /* Section of member functions that may bring size changes. */
 
     constexpr void push_back(bool __x) {
         using namespace __detail::__bitset;
-        if (const auto __mod = length++ % __WBits) {
-            data(div_down(length)) |= (_Word_t(__x) << __mod);
+        if (const auto __mod = length++ % word_bits <_Word>) {
+            if (__x) data(div_down <_Word> (length)) |= mask_pos <_Word> (__mod);
         } else { // Full word, so grow the storage by 1.
             this->grow_full(__x);
         }
@@ -594,16 +778,20 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
   public:
     void debug() {
         using namespace __detail::__bitset;
-        const auto [__div, __mod] = div_mod(length);
+        constexpr auto __Bits = word_bits <_Word>;
+        const auto [__div, __mod] = div_mod <_Word> (length);
+        const auto __to_string = [](const _Word &__w) {
+            std::string __str(__Bits, '0');
+            for (size_t i = 0 ; i != __Bits ; ++i)
+                if (_Traits_t::test(__w, i)) __str[i] = '1';
+            return __str;
+        };
         for (size_t i = 0 ; i != __div ; ++i) {
-            auto __str = std::bitset <__WBits> (data(i)).to_string();
-            std::reverse(__str.begin(), __str.end());
-            std::cout << __str << '\n';
+            std::cout << __to_string(data(i)) << '\n';
         }
         if (__mod != 0) {
-            auto __str = std::bitset <__WBits> (data(__div)).to_string();
-            std::reverse(__str.begin(), __str.end());
-            for (size_t i = __mod ; i != __WBits ; ++i)
+            auto __str = __to_string(data(__div));
+            for (size_t i = __mod ; i != __Bits ; ++i)
                 if (__str[i] != '0') throw std::runtime_error("Invalid bitset.");
                 else __str[i] = '-';
             std::cout << __str << '\n';
@@ -616,5 +804,13 @@ struct dynamic_bitset : private __detail::__bitset::dynamic_storage {
     }
 };
 
+/* The dynamic bitset of the default 64-bit word. */
+using dynamic_bitset = basic_dynamic_bitset <>;
+
+/* A vector block of _Bits bits, as the word of basic_dynamic_bitset. */
+template <size_t _Bits>
+requires (_Bits == 128 || _Bits == 256 || _Bits == 512)
+using wide_block = __detail::__bitset::wide_word <_Bits / 64>;
+
 
 } // namespace dark
@@ -0,0 +1,357 @@
+#pragma once
+#include "bitset.h"
+#include <span>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dark {
+
+
+namespace __detail::__bloom {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Bytes of a cache line, the size of a block. */
+inline constexpr size_t __BlockBytes = 64;
+/* Words in a block. */
+inline constexpr size_t __BlockWords = __BlockBytes / sizeof(_Word_t);
+/* Bits in a block. */
+inline constexpr size_t __BlockBits  = __BlockWords * __WBits;
+/* Keys processed together in batched operations. */
+inline constexpr size_t __Batch = 16;
+
+/* One odd multiplier per word, as in the split block Bloom filter. */
+inline constexpr std::uint32_t __Salt[__BlockWords] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+/* Mix the bits of a key (murmur3 finalizer). */
+inline constexpr std::uint64_t mix(std::uint64_t __x) {
+    __x ^= __x >> 33;
+    __x *= 0xff51afd7ed558ccdULL;
+    __x ^= __x >> 33;
+    __x *= 0xc4ceb9fe1a85ec53ULL;
+    __x ^= __x >> 33;
+    return __x;
+}
+
+/* Index of the block of a hash, in [0, __n). */
+inline constexpr size_t block_of(std::uint64_t __h, size_t __n) {
+    return static_cast <size_t> (((__h >> 32) * __n) >> 32);
+}
+
+/* Index in [0, 2^__b) of word __i, picked by the low half of a hash. */
+template <size_t _Bits>
+inline constexpr std::uint32_t lane_of(std::uint64_t __h, size_t __i) {
+    return (static_cast <std::uint32_t> (__h) * __Salt[__i]) >> (32 - _Bits);
+}
+
+/* One bit in each word of a block, computed in 8 SIMD lanes. */
+inline constexpr void make_mask(std::uint64_t __h, _Word_t *__mask) {
+#if defined(__AVX2__)
+    if (!std::is_constant_evaluated()) {
+        const auto __salt = _mm256_loadu_si256(reinterpret_cast <const __m256i *> (__Salt));
+        const auto __key  = _mm256_set1_epi32(static_cast <int> (__h));
+        const auto __pos  = _mm256_srli_epi32(_mm256_mullo_epi32(__key, __salt), 26);
+        const auto __one  = _mm256_set1_epi64x(1);
+        const auto __lo = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(__pos));
+        const auto __hi = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(__pos, 1));
+        _mm256_storeu_si256(reinterpret_cast <__m256i *> (__mask + 0), _mm256_sllv_epi64(__one, __lo));
+        _mm256_storeu_si256(reinterpret_cast <__m256i *> (__mask + 4), _mm256_sllv_epi64(__one, __hi));
+        return;
+    }
+#endif
+    for (size_t i = 0 ; i != __BlockWords ; ++i)
+        __mask[i] = _Word_t{1} << lane_of <6> (__h, i);
+}
+
+/**
+ * Storage of cache-line blocks in a dynamic_bitset.
+ * The allocator does not align to cache lines, so one spare
+ * block is allocated and the blocks start at the first aligned word.
+ * Only the block region is copied, compared or serialized.
+ */
+struct block_storage {
+  protected:
+    dynamic_bitset  bits;   // Raw storage, with one spare block
+    size_t          count;  // Count of blocks
+
+    /* Words from __ptr to the first cache-line aligned word. */
+    static size_t skew_of(const _Word_t *__ptr) {
+        const auto __addr = reinterpret_cast <std::uintptr_t> (__ptr);
+        return (-__addr % __BlockBytes) / sizeof(_Word_t);
+    }
+
+    /* First word of the aligned block region. */
+    _Word_t *blocks() { return bits.data() + skew_of(bits.data()); }
+    const _Word_t *blocks() const { return bits.data() + skew_of(bits.data()); }
+
+    _Word_t *block(size_t __n) { return this->blocks() + __n * __BlockWords; }
+    const _Word_t *block(size_t __n) const { return this->blocks() + __n * __BlockWords; }
+
+    /* Check that there is any block to write, i.e. not moved-from. */
+    void check_blocks() const {
+        if (count == 0)
+            throw std::logic_error("bloom_filter: no block, moved-from?");
+    }
+
+    /* Check that two filters have the same shape. */
+    void check_shape(const block_storage &rhs) const {
+        if (count != rhs.count)
+            throw std::invalid_argument("bloom_filter: block count mismatch");
+    }
+
+    /* Empty state, as left by a move. */
+    block_storage() noexcept : bits(), count(0) {}
+
+  public:
+    explicit block_storage(size_t __n)
+        : bits((__n + 1) * __BlockBits), count(__n) {
+        if (__n == 0) throw std::invalid_argument("bloom_filter: no block");
+    }
+
+    /* Load from words produced by words(). */
+    explicit block_storage(std::span <const _Word_t> __words)
+        : block_storage(__words.size() / __BlockWords) {
+        if (__words.size() % __BlockWords != 0)
+            throw std::invalid_argument("bloom_filter: partial block");
+        __bitset::word_copy(this->blocks(), __words.data(), __words.size());
+    }
+
+    block_storage(const block_storage &rhs) : block_storage() {
+        if (rhs.count != 0) *this = block_storage { rhs.words() };
+    }
+    /* The source is left empty, with no block. */
+    block_storage(block_storage &&rhs) noexcept
+        : bits(std::move(rhs.bits)), count(std::exchange(rhs.count, 0)) {}
+
+    block_storage &operator = (const block_storage &rhs) {
+        if (this == &rhs) return *this;
+        block_storage __tmp { rhs };
+        return *this = std::move(__tmp);
+    }
+    block_storage &operator = (block_storage &&rhs) noexcept {
+        std::swap(bits, rhs.bits);
+        std::swap(count, rhs.count);
+        return *this;
+    }
+
+    /* Words of all blocks, for serialization. */
+    std::span <const _Word_t> words() const {
+        return { this->blocks(), count * __BlockWords };
+    }
+
+    /* Count of cache-line blocks. */
+    size_t block_count() const { return count; }
+
+    /* Remove all the keys. */
+    void clear() {
+        if (count != 0) __bitset::word_reset(this->blocks(), 0, count * __BlockWords);
+    }
+
+    bool operator == (const block_storage &rhs) const {
+        if (count != rhs.count) return false;
+        const auto *__lhs = this->blocks();
+        const auto *__rhs = rhs.blocks();
+        for (size_t i = 0 ; i != count * __BlockWords ; ++i)
+            if (__lhs[i] != __rhs[i]) return false;
+        return true;
+    }
+};
+
+} // namespace __detail::__bloom
+
+
+/**
+ * @brief A cache-line blocked Bloom filter over 64-bit keys.
+ * Each key maps to one 64-byte block and sets one bit in every
+ * word of it (8 probes), so a probe touches exactly one cache line.
+ * The 8 bits of a block are computed in parallel SIMD lanes, and
+ * batched operations prefetch the blocks of a group of keys first.
+ *
+ * Keys are mixed internally, so raw integers or hashes both work.
+ */
+struct blocked_bloom_filter : __detail::__bloom::block_storage {
+  private:
+    using _Base_t = __detail::__bloom::block_storage;
+    using _Word_t = __detail::__bloom::_Word_t;
+
+  public:
+    using _Base_t::_Base_t;
+
+    /* Blocks needed for __n keys at __bits bits per key. */
+    static constexpr size_t blocks_for(size_t __n, size_t __bits = 16) {
+        const auto __need = (__n * __bits + __detail::__bloom::__BlockBits - 1)
+                          / __detail::__bloom::__BlockBits;
+        return __need | !__need;
+    }
+
+    /* Insert a key. Throw std::logic_error on a moved-from filter. */
+    void insert(std::uint64_t __key) {
+        using namespace __detail::__bloom;
+        this->check_blocks();
+        const auto __h = mix(__key);
+        _Word_t __mask[__BlockWords];
+        make_mask(__h, __mask);
+        auto *__blk = this->block(block_of(__h, count));
+        for (size_t i = 0 ; i != __BlockWords ; ++i) __blk[i] |= __mask[i];
+    }
+
+    /* Whether a key may exist. Always false on a moved-from filter. */
+    bool contains(std::uint64_t __key) const {
+        using namespace __detail::__bloom;
+        if (count == 0) return false;
+        const auto __h = mix(__key);
+        _Word_t __mask[__BlockWords];
+        make_mask(__h, __mask);
+        const auto *__blk = this->block(block_of(__h, count));
+        _Word_t __miss = 0;
+        for (size_t i = 0 ; i != __BlockWords ; ++i) __miss |= __mask[i] & ~__blk[i];
+        return __miss == 0;
+    }
+
+    /* Insert keys in batches, prefetching blocks ahead of use. */
+    void insert_many(std::span <const std::uint64_t> __keys) {
+        using namespace __detail::__bloom;
+        this->check_blocks();
+        std::uint64_t __h[__Batch];
+        for (size_t __base = 0 ; __base < __keys.size() ; __base += __Batch) {
+            const auto __n = std::min(__Batch, __keys.size() - __base);
+            for (size_t j = 0 ; j != __n ; ++j) {
+                __h[j] = mix(__keys[__base + j]);
+                __builtin_prefetch(this->block(block_of(__h[j], count)), 1);
+            }
+            for (size_t j = 0 ; j != __n ; ++j) {
+                _Word_t __mask[__BlockWords];
+                make_mask(__h[j], __mask);
+                auto *__blk = this->block(block_of(__h[j], count));
+                for (size_t i = 0 ; i != __BlockWords ; ++i) __blk[i] |= __mask[i];
+            }
+        }
+    }
+
+    /* Test keys in batches. Bit i of the result tells whether key i may exist. */
+    dynamic_bitset contains_many(std::span <const std::uint64_t> __keys) const {
+        using namespace __detail::__bloom;
+        dynamic_bitset __ret(__keys.size());
+        if (count == 0) return __ret;
+        std::uint64_t __h[__Batch];
+        for (size_t __base = 0 ; __base < __keys.size() ; __base += __Batch) {
+            const auto __n = std::min(__Batch, __keys.size() - __base);
+            for (size_t j = 0 ; j != __n ; ++j) {
+                __h[j] = mix(__keys[__base + j]);
+                __builtin_prefetch(this->block(block_of(__h[j], count)), 0);
+            }
+            for (size_t j = 0 ; j != __n ; ++j) {
+                _Word_t __mask[__BlockWords];
+                make_mask(__h[j], __mask);
+                const auto *__blk = this->block(block_of(__h[j], count));
+                _Word_t __miss = 0;
+                for (size_t i = 0 ; i != __BlockWords ; ++i) __miss |= __mask[i] & ~__blk[i];
+                if (__miss == 0) __ret.set(__base + j);
+            }
+        }
+        return __ret;
+    }
+
+    /* Union of keys. Both filters must have the same block count. */
+    blocked_bloom_filter &operator |= (const blocked_bloom_filter &rhs) {
+        this->check_shape(rhs);
+        __detail::__bitset::do_or_(this->blocks(), rhs.blocks(),
+            count * __detail::__bloom::__BlockBits);
+        return *this;
+    }
+
+    /* Intersection of keys (may keep extra false positives). */
+    blocked_bloom_filter &operator &= (const blocked_bloom_filter &rhs) {
+        this->check_shape(rhs);
+        __detail::__bitset::do_and(this->blocks(), rhs.blocks(),
+            count * __detail::__bloom::__BlockBits);
+        return *this;
+    }
+};
+
+
+/**
+ * @brief A cache-line blocked counting Bloom filter over 64-bit keys.
+ * A block holds 128 4-bit counters, 16 in each word. Each key maps
+ * to one block and one counter in every word of it, so insert and
+ * erase touch exactly one cache line. Counters saturate at 15 and
+ * are never decremented once saturated.
+ */
+struct counting_bloom_filter : __detail::__bloom::block_storage {
+  private:
+    using _Base_t = __detail::__bloom::block_storage;
+    using _Word_t = __detail::__bloom::_Word_t;
+
+    inline static constexpr size_t  __CBits = 4;
+    inline static constexpr _Word_t __CMax  = (1 << __CBits) - 1;
+
+    /* Bit offset of the counter of a key in word __i. */
+    static constexpr size_t shift_of(std::uint64_t __h, size_t __i) {
+        return __detail::__bloom::lane_of <4> (__h, __i) * __CBits;
+    }
+
+  public:
+    using _Base_t::_Base_t;
+
+    /* Insert a key. Throw std::logic_error on a moved-from filter. */
+    void insert(std::uint64_t __key) {
+        using namespace __detail::__bloom;
+        this->check_blocks();
+        const auto __h = mix(__key);
+        auto *__blk = this->block(block_of(__h, count));
+        for (size_t i = 0 ; i != __BlockWords ; ++i) {
+            const auto __s = shift_of(__h, i);
+            if (((__blk[i] >> __s) & __CMax) != __CMax)
+                __blk[i] += _Word_t{1} << __s;
+        }
+    }
+
+    /* Erase a key that was inserted before. */
+    void erase(std::uint64_t __key) {
+        using namespace __detail::__bloom;
+        this->check_blocks();
+        const auto __h = mix(__key);
+        auto *__blk = this->block(block_of(__h, count));
+        for (size_t i = 0 ; i != __BlockWords ; ++i) {
+            const auto __s = shift_of(__h, i);
+            const auto __c = (__blk[i] >> __s) & __CMax;
+            if (__c != 0 && __c != __CMax)
+                __blk[i] -= _Word_t{1} << __s;
+        }
+    }
+
+    /* Whether a key may exist. Always false on a moved-from filter. */
+    bool contains(std::uint64_t __key) const {
+        using namespace __detail::__bloom;
+        if (count == 0) return false;
+        const auto __h = mix(__key);
+        const auto *__blk = this->block(block_of(__h, count));
+        bool __ret = true;
+        for (size_t i = 0 ; i != __BlockWords ; ++i)
+            __ret &= ((__blk[i] >> shift_of(__h, i)) & __CMax) != 0;
+        return __ret;
+    }
+
+    void insert_many(std::span <const std::uint64_t> __keys) {
+        for (const auto __key : __keys) this->insert(__key);
+    }
+
+    /* Bit i of the result tells whether key i may exist. */
+    dynamic_bitset contains_many(std::span <const std::uint64_t> __keys) const {
+        dynamic_bitset __ret(__keys.size());
+        for (size_t i = 0 ; i != __keys.size() ; ++i)
+            if (this->contains(__keys[i])) __ret.set(i);
+        return __ret;
+    }
+};
+
+
+} // namespace dark
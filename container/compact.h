@@ -0,0 +1,185 @@
+#pragma once
+#include "bitset.h"
+#include <span>
+#include <cstdint>
+#include <type_traits>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace dark {
+
+
+namespace __detail::__compact {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Element types that can be compacted (int32, int64, float, double...). */
+template <class _Tp>
+concept compactable = std::is_trivially_copyable_v <_Tp>
+    && (sizeof(_Tp) == 4 || sizeof(_Tp) == 8);
+
+/* Copy the elements whose bit is set, one by one. */
+template <class _Tp>
+inline constexpr size_t
+scalar_word(_Word_t __w, const _Tp *__in, _Tp *__out) {
+    size_t __n = 0;
+    while (__w != 0) {
+        __out[__n++] = __in[std::countr_zero(__w)];
+        __w &= __w - 1;
+    }
+    return __n;
+}
+
+#if !defined(__AVX512F__) && defined(__AVX2__)
+
+/* Permutation tables for _mm256_permutevar8x32_epi32. */
+struct shuffle_table {
+    alignas(32) std::uint32_t b32[256][8];  // 8 x 32-bit lanes, 8-bit mask
+    alignas(32) std::uint32_t b64[16][8];   // 4 x 64-bit lanes, 4-bit mask
+};
+
+consteval shuffle_table make_shuffle_table() {
+    shuffle_table __ret {};
+    for (std::uint32_t __m = 0 ; __m != 256 ; ++__m) {
+        std::uint32_t __k = 0;
+        for (std::uint32_t j = 0 ; j != 8 ; ++j)
+            if ((__m >> j) & 1) __ret.b32[__m][__k++] = j;
+    }
+    for (std::uint32_t __m = 0 ; __m != 16 ; ++__m) {
+        std::uint32_t __k = 0;
+        for (std::uint32_t j = 0 ; j != 4 ; ++j)
+            if ((__m >> j) & 1) {
+                __ret.b64[__m][__k++] = j * 2;
+                __ret.b64[__m][__k++] = j * 2 + 1;
+            }
+    }
+    return __ret;
+}
+
+inline constexpr shuffle_table __Shuffle = make_shuffle_table();
+
+#endif
+
+/**
+ * Copy the elements whose bit is set with SIMD.
+ * It may write garbage to __out[popcount(__w), 64),
+ * so the caller must leave at least 64 slots.
+ */
+template <class _Tp>
+inline size_t simd_word(_Word_t __w, const _Tp *__in, _Tp *__out) {
+#if defined(__AVX512F__)
+    const auto *__src = __in;
+    auto *__dst = __out;
+    if constexpr (sizeof(_Tp) == 4) {
+        for (size_t j = 0 ; j != __WBits ; j += 16) {
+            const auto __m = static_cast <__mmask16> (__w >> j);
+            _mm512_mask_compressstoreu_epi32(__dst, __m, _mm512_loadu_si512(__src + j));
+            __dst += std::popcount(static_cast <std::uint16_t> (__m));
+        }
+    } else {
+        for (size_t j = 0 ; j != __WBits ; j += 8) {
+            const auto __m = static_cast <__mmask8> (__w >> j);
+            _mm512_mask_compressstoreu_epi64(__dst, __m, _mm512_loadu_si512(__src + j));
+            __dst += std::popcount(static_cast <std::uint8_t> (__m));
+        }
+    }
+    return __dst - __out;
+#elif defined(__AVX2__)
+    auto *__dst = __out;
+    if constexpr (sizeof(_Tp) == 4) {
+        for (size_t j = 0 ; j != __WBits ; j += 8) {
+            const auto __m = static_cast <std::uint8_t> (__w >> j);
+            const auto __v = _mm256_loadu_si256(reinterpret_cast <const __m256i *> (__in + j));
+            const auto __p = _mm256_load_si256(reinterpret_cast <const __m256i *> (__Shuffle.b32[__m]));
+            _mm256_storeu_si256(reinterpret_cast <__m256i *> (__dst), _mm256_permutevar8x32_epi32(__v, __p));
+            __dst += std::popcount(__m);
+        }
+    } else {
+        for (size_t j = 0 ; j != __WBits ; j += 4) {
+            const auto __m = static_cast <std::uint8_t> ((__w >> j) & 0xF);
+            const auto __v = _mm256_loadu_si256(reinterpret_cast <const __m256i *> (__in + j));
+            const auto __p = _mm256_load_si256(reinterpret_cast <const __m256i *> (__Shuffle.b64[__m]));
+            _mm256_storeu_si256(reinterpret_cast <__m256i *> (__dst), _mm256_permutevar8x32_epi32(__v, __p));
+            __dst += std::popcount(__m);
+        }
+    }
+    return __dst - __out;
+#else
+    return scalar_word(__w, __in, __out);
+#endif
+}
+
+/**
+ * Compact one word worth of elements.
+ * __full tells whether all 64 input elements are readable,
+ * __room is the number of writable slots in __out.
+ */
+template <class _Tp>
+inline constexpr size_t
+compact_word(_Word_t __w, const _Tp *__in, _Tp *__out, bool __full, size_t __room) {
+    if (__w == ~_Word_t{0}) { // Dense word, plain copy.
+        if (std::is_constant_evaluated()) {
+            for (size_t i = 0 ; i != __WBits ; ++i) __out[i] = __in[i];
+        } else {
+            std::memcpy(__out, __in, __WBits * sizeof(_Tp));
+        }
+        return __WBits;
+    }
+    if (std::is_constant_evaluated() || !__full || __room < __WBits)
+        return scalar_word(__w, __in, __out);
+    else
+        return simd_word(__w, __in, __out);
+}
+
+} // namespace __detail::__compact
+
+
+/* A pair of input and output arrays for multi-column compact. */
+template <__detail::__compact::compactable _Tp>
+struct compact_column {
+    std::span <const _Tp>   in;
+    std::span <_Tp>         out;
+};
+
+/**
+ * @brief Compact several parallel columns with the same mask.
+ * Each word of the mask is loaded once and applied to every column.
+ * @return Count of rows written to each column.
+ */
+template <__detail::__compact::compactable ..._Tp>
+requires (sizeof...(_Tp) > 0)
+inline constexpr size_t
+compact(const dynamic_bitset &__mask, compact_column <_Tp> ...__col) {
+    using namespace __detail::__compact;
+    const auto __size = __mask.word_count();
+    const auto __last = __mask.size() / __WBits; // First word not full.
+    size_t __n = 0;
+    for (size_t i = 0 ; i != __size ; ++i) {
+        const auto __w = __mask.data(i);
+        if (__w == 0) continue; // Sparse word, skip.
+        const auto __base = i * __WBits;
+        const auto __full = i < __last;
+        size_t __cnt = 0;
+        ((__cnt = compact_word(__w, __col.in.data() + __base,
+            __col.out.data() + __n, __full, __col.out.size() - __n)), ...);
+        __n += __cnt;
+    }
+    return __n;
+}
+
+
+/**
+ * @brief Copy in[i] for every set bit i of the mask to out, in order.
+ * @return Count of elements written, which is __mask.count().
+ * @note in must hold at least __mask.size() elements,
+ * and out must hold at least __mask.count() elements.
+ */
+template <__detail::__compact::compactable _Tp>
+inline constexpr size_t
+compact(const dynamic_bitset &__mask, std::span <const _Tp> __in, std::span <_Tp> __out) {
+    return compact(__mask, compact_column <_Tp> { __in, __out });
+}
+
+} // namespace dark
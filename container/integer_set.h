@@ -0,0 +1,315 @@
+#pragma once
+#include "bitset.h"
+#include "../utility/bit.h"
+
+namespace dark {
+
+
+struct integer_set;
+
+
+namespace __detail::__integer_set {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* log2 of word bits, the fan-out of each level. */
+inline constexpr size_t __Shift = std::countr_zero(__WBits);
+
+/* Max levels needed to cover a 64-bit universe. */
+inline constexpr size_t __Depth = (sizeof(size_t) * CHAR_BIT + __Shift - 1) / __Shift;
+
+/* Mask of the bit index inside a word. */
+inline constexpr size_t __Mask = __WBits - 1;
+
+/* Keep bits [__n, 64) of the word. */
+inline constexpr _Word_t mask_from(size_t __n) { return __bitset::mask_top(__n); }
+
+/* Keep bits [0, __n] of the word. */
+inline constexpr _Word_t mask_upto(size_t __n) { return ~_Word_t{0} >> (__Mask ^ __n); }
+
+/* Index of lowest set bit. Word must not be 0. */
+inline constexpr size_t low_index(_Word_t __w) { return std::countr_zero(__w); }
+
+/* Index of highest set bit. Word must not be 0. */
+inline constexpr size_t top_index(_Word_t __w) { return ::dark::log2(__w); }
+
+/* Forward iterator over the keys of an integer_set. */
+struct iterator {
+  private:
+    const integer_set * set;    // Set to iterate over
+    size_t              key;    // Current key, npos if at the end
+    size_t              last;   // Exclusive upper bound of the range
+
+    friend struct ::dark::integer_set;
+
+    constexpr iterator(const integer_set *__set, size_t __key, size_t __last)
+    noexcept : set(__set), key(__key), last(__last) {}
+
+  public:
+    using value_type        = size_t;
+    using difference_type   = ptrdiff_t;
+    using iterator_category = std::forward_iterator_tag;
+
+    constexpr iterator() noexcept : set(nullptr), key(-1), last(0) {}
+
+    constexpr size_t operator * () const { return key; }
+
+    constexpr iterator &operator ++ ();
+    constexpr iterator operator ++ (int) { auto __tmp = *this; ++*this; return __tmp; }
+
+    constexpr bool operator == (const iterator &rhs) const { return key == rhs.key; }
+};
+
+/* A half-open range [first, last) of keys. */
+struct range {
+    iterator first;
+    iterator last;
+    constexpr iterator begin() const { return first; }
+    constexpr iterator end()   const { return last;  }
+};
+
+} // namespace __detail::__integer_set
+
+
+/**
+ * @brief A fixed-universe integer set.
+ * Keys live in [0, universe), stored as a 64-ary tree of words.
+ * Level 0 is a flat bitset of the keys, and bit i of level k + 1
+ * is set iff word i of level k is non-zero. The summary levels cost
+ * about 1/63 of the leaf level in memory.
+ *
+ * Every operation touches at most one word per level,
+ * which is O(log64 U): 6 levels for a 2^32 universe.
+ */
+struct integer_set {
+  public:
+    using iterator = __detail::__integer_set::iterator;
+    using range_t  = __detail::__integer_set::range;
+
+    inline static constexpr size_t npos = -1;
+
+  private:
+    using _Word_t = __detail::__integer_set::_Word_t;
+
+    _Word_t *   head;       // Pointer to all the words
+    size_t      buffer;     // Total words of all levels
+    size_t      universe;   // Keys must be less than it
+    size_t      number;     // Count of keys in the set
+    size_t      depth;      // Count of levels
+
+    size_t offset[__detail::__integer_set::__Depth + 1]; // Word offset of each level
+
+    constexpr _Word_t *level(size_t __k) const { return head + offset[__k]; }
+    constexpr size_t   words(size_t __k) const { return offset[__k + 1] - offset[__k]; }
+
+    /* Build the layout of levels for given universe. */
+    constexpr void layout(size_t __n) {
+        using namespace __detail::__bitset;
+        universe = __n;
+        number   = 0;
+        depth    = 0;
+        offset[0] = 0;
+        size_t __cnt = div_ceil(__n) | !__n; // At least one word.
+        while (true) {
+            offset[depth + 1] = offset[depth] + __cnt;
+            ++depth;
+            if (__cnt == 1) break;
+            __cnt = div_ceil(__cnt);
+        }
+        buffer = offset[depth];
+    }
+
+    /* Reset to an empty universe without memory. */
+    constexpr void reset() {
+        head = nullptr;
+        buffer = universe = number = depth = 0;
+        for (auto &__off : offset) __off = 0;
+    }
+
+    /* Smallest key >= __x, or npos. */
+    constexpr size_t find_ge(size_t __x) const {
+        using namespace __detail::__integer_set;
+        if (__x >= universe) return npos;
+        size_t __k = 0;
+        while (true) {
+            if (__k == depth) return npos;
+            const size_t __idx = __x >> __Shift;
+            if (__idx >= words(__k)) return npos;
+            const auto __w = level(__k)[__idx] & mask_from(__x & __Mask);
+            if (__w != 0) { __x = __idx << __Shift | low_index(__w); break; }
+            __x = __idx + 1; ++__k;
+        }
+        while (__k-- != 0)
+            __x = __x << __Shift | low_index(level(__k)[__x]);
+        return __x;
+    }
+
+    /* Largest key <= __x, or npos. */
+    constexpr size_t find_le(size_t __x) const {
+        using namespace __detail::__integer_set;
+        if (universe == 0) return npos;
+        if (__x >= universe) __x = universe - 1;
+        size_t __k = 0;
+        while (true) {
+            if (__k == depth) return npos;
+            const size_t __idx = __x >> __Shift;
+            const auto __w = level(__k)[__idx] & mask_upto(__x & __Mask);
+            if (__w != 0) { __x = __idx << __Shift | top_index(__w); break; }
+            if (__idx == 0) return npos;
+            __x = __idx - 1; ++__k;
+        }
+        while (__k-- != 0)
+            __x = __x << __Shift | top_index(level(__k)[__x]);
+        return __x;
+    }
+
+    constexpr void range_check(size_t __x) const {
+        if (__x >= universe)
+            throw std::out_of_range("integer_set::range_check");
+    }
+
+  public:
+    /* ctor & operator section. */
+
+    constexpr integer_set() : integer_set(0) {}
+
+    /* Create an empty set of keys in [0, __n). */
+    constexpr explicit integer_set(size_t __n) {
+        this->layout(__n);
+        head = __detail::__bitset::alloc_zero(buffer);
+    }
+
+    constexpr ~integer_set() noexcept { __detail::__bitset::deallocate(head, buffer); }
+
+    constexpr integer_set(const integer_set &rhs) : integer_set(rhs.universe) {
+        __detail::__bitset::word_copy(head, rhs.head, buffer);
+        number = rhs.number;
+    }
+
+    constexpr integer_set(integer_set &&rhs) noexcept {
+        this->reset();
+        this->swap(rhs);
+    }
+
+    constexpr integer_set &operator = (const integer_set &rhs) {
+        if (this == &rhs) return *this;
+        integer_set __tmp { rhs };
+        return this->swap(__tmp);
+    }
+
+    constexpr integer_set &operator = (integer_set &&rhs)
+    noexcept { return this->swap(rhs); }
+
+    constexpr integer_set &swap(integer_set &rhs) noexcept {
+        std::swap(head, rhs.head);
+        std::swap(buffer, rhs.buffer);
+        std::swap(universe, rhs.universe);
+        std::swap(number, rhs.number);
+        std::swap(depth, rhs.depth);
+        std::swap(offset, rhs.offset);
+        return *this;
+    }
+
+  public:
+    /* Function section. */
+
+    /**
+     * @brief Insert a key. Return whether it is newly inserted.
+     * @throw std::out_of_range if __x is not in [0, universe).
+     */
+    constexpr bool insert(size_t __x) {
+        using namespace __detail::__integer_set;
+        this->range_check(__x);
+        for (size_t __k = 0 ; __k != depth ; ++__k) {
+            auto &__w = level(__k)[__x >> __Shift];
+            const auto __old = __w;
+            __w |= __detail::__bitset::mask_pos(__x & __Mask);
+            if (__k == 0) {
+                if (__old == __w) return false;
+                ++number;
+            }
+            if (__old != 0) break; // Upper levels are already set.
+            __x >>= __Shift;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Erase a key. Return whether it was in the set.
+     * @throw std::out_of_range if __x is not in [0, universe).
+     */
+    constexpr bool erase(size_t __x) {
+        using namespace __detail::__integer_set;
+        this->range_check(__x);
+        for (size_t __k = 0 ; __k != depth ; ++__k) {
+            auto &__w = level(__k)[__x >> __Shift];
+            const auto __old = __w;
+            __w &= ~__detail::__bitset::mask_pos(__x & __Mask);
+            if (__k == 0) {
+                if (__old == __w) return false;
+                --number;
+            }
+            if (__w != 0) break; // Upper levels are still set.
+            __x >>= __Shift;
+        }
+        return true;
+    }
+
+    /* Return whether a key is in the set. */
+    constexpr bool contains(size_t __x) const {
+        using namespace __detail::__integer_set;
+        if (__x >= universe) return false;
+        return (level(0)[__x >> __Shift] >> (__x & __Mask)) & 1;
+    }
+
+    /* Smallest key >= __x, or npos. */
+    constexpr size_t lower_bound(size_t __x) const { return this->find_ge(__x); }
+    /* Smallest key > __x, or npos. */
+    constexpr size_t successor(size_t __x) const {
+        return __x == npos ? npos : this->find_ge(__x + 1);
+    }
+    /* Largest key < __x, or npos. */
+    constexpr size_t predecessor(size_t __x) const {
+        return __x == 0 ? npos : this->find_le(__x - 1);
+    }
+
+    /* Smallest key in the set, or npos. */
+    constexpr size_t min() const { return this->find_ge(0); }
+    /* Largest key in the set, or npos. */
+    constexpr size_t max() const { return this->find_le(npos); }
+
+    /* Remove all the keys. */
+    constexpr void clear() {
+        __detail::__bitset::word_reset(head, 0, buffer);
+        number = 0;
+    }
+
+    constexpr bool   empty()    const { return number == 0; }
+    constexpr size_t size()     const { return number; }
+    constexpr size_t capacity() const { return universe; }
+
+    constexpr iterator begin() const { return iterator(this, this->min(), npos); }
+    constexpr iterator end()   const { return iterator(this, npos, npos); }
+
+    /* Keys in [__first, __last), in ascending order. */
+    constexpr range_t range(size_t __first, size_t __last) const {
+        auto __key = this->find_ge(__first);
+        if (__key >= __last) __key = npos;
+        return { iterator(this, __key, __last), this->end() };
+    }
+};
+
+
+namespace __detail::__integer_set {
+
+constexpr iterator &iterator::operator ++ () {
+    key = set->successor(key);
+    if (key >= last) key = integer_set::npos;
+    return *this;
+}
+
+} // namespace __detail::__integer_set
+
+
+} // namespace dark
@@ -0,0 +1,321 @@
+#pragma once
+#include "bitset.h"
+#include <span>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <concepts>
+
+namespace dark {
+
+
+/* Width tag of a packed_vector whose width is chosen at runtime. */
+inline constexpr size_t dynamic_width = 0;
+
+template <size_t _Bits>
+struct packed_vector;
+
+
+namespace __detail::__packed {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Max bits of one element. */
+inline constexpr size_t __MaxBits = __WBits;
+
+/* Set first __n low bits to 1, where 0 < __n <= 64. */
+inline constexpr _Word_t mask_bits(size_t __n) { return ~_Word_t{0} >> (__WBits - __n); }
+
+/* Read __b bits starting at bit __pos. */
+inline constexpr _Word_t
+get_bits(const _Word_t *__src, size_t __pos, size_t __b) {
+    const auto [__div, __mod] = __bitset::div_mod(__pos);
+    auto __ret = __src[__div] >> __mod;
+    if (__mod + __b > __WBits) // Cross the word boundary.
+        __ret |= __src[__div + 1] << __bitset::rev_bits(__mod);
+    return __ret & mask_bits(__b);
+}
+
+/* Write __b bits starting at bit __pos. __val must fit in __b bits. */
+inline constexpr void
+set_bits(_Word_t *__dst, size_t __pos, size_t __b, _Word_t __val) {
+    const auto [__div, __mod] = __bitset::div_mod(__pos);
+    const auto __msk = mask_bits(__b);
+    __dst[__div] = (__dst[__div] & ~(__msk << __mod)) | (__val << __mod);
+    if (__mod + __b > __WBits) { // Cross the word boundary.
+        const auto __rev = __bitset::rev_bits(__mod);
+        __dst[__div + 1] = (__dst[__div + 1] & ~(__msk >> __rev)) | (__val >> __rev);
+    }
+}
+
+/**
+ * 64 elements of _Bits bits fill exactly _Bits words,
+ * so bulk transfer works on such aligned blocks. With the
+ * width known at compile time, the fully unrolled loop turns
+ * into straight-line shifts and masks without any branch.
+ */
+template <size_t _Bits, class _Tp>
+inline constexpr void unpack_block(const _Word_t *__src, _Tp *__dst) {
+#pragma GCC unroll 64
+    for (size_t j = 0 ; j != __WBits ; ++j)
+        __dst[j] = static_cast <_Tp> (get_bits(__src, j * _Bits, _Bits));
+}
+
+/* Pack a block of 64 elements into _Bits words, overwriting them. */
+template <size_t _Bits, class _Tp>
+inline constexpr void pack_block(const _Tp *__src, _Word_t *__dst) {
+    constexpr auto __msk = mask_bits(_Bits);
+    for (size_t i = 0 ; i != _Bits ; ++i) __dst[i] = 0;
+#pragma GCC unroll 64
+    for (size_t j = 0 ; j != __WBits ; ++j) {
+        const auto [__div, __mod] = __bitset::div_mod(j * _Bits);
+        const auto __val = static_cast <_Word_t> (__src[j]) & __msk;
+        __dst[__div] |= __val << __mod;
+        if (__mod + _Bits > __WBits)
+            __dst[__div + 1] |= __val >> __bitset::rev_bits(__mod);
+    }
+}
+
+template <class _Tp>
+using unpack_fn = void (*)(const _Word_t *, _Tp *);
+template <class _Tp>
+using pack_fn   = void (*)(const _Tp *, _Word_t *);
+
+/* Kernel tables indexed by width, for runtime width. */
+template <class _Tp, size_t ..._Idx>
+consteval auto make_unpack(std::index_sequence <_Idx...>) {
+    return std::array <unpack_fn <_Tp>, sizeof...(_Idx) + 1> {
+        nullptr, unpack_block <_Idx + 1, _Tp>...
+    };
+}
+
+template <class _Tp, size_t ..._Idx>
+consteval auto make_pack(std::index_sequence <_Idx...>) {
+    return std::array <pack_fn <_Tp>, sizeof...(_Idx) + 1> {
+        nullptr, pack_block <_Idx + 1, _Tp>...
+    };
+}
+
+/* Return the unpack kernel of given width. */
+template <size_t _Bits, class _Tp>
+inline constexpr unpack_fn <_Tp> get_unpack(size_t __b) {
+    if constexpr (_Bits != dynamic_width) {
+        return unpack_block <_Bits, _Tp>;
+    } else {
+        constexpr auto __table = make_unpack <_Tp> (std::make_index_sequence <__MaxBits> {});
+        return __table[__b];
+    }
+}
+
+/* Return the pack kernel of given width. */
+template <size_t _Bits, class _Tp>
+inline constexpr pack_fn <_Tp> get_pack(size_t __b) {
+    if constexpr (_Bits != dynamic_width) {
+        return pack_block <_Bits, _Tp>;
+    } else {
+        constexpr auto __table = make_pack <_Tp> (std::make_index_sequence <__MaxBits> {});
+        return __table[__b];
+    }
+}
+
+/* Holder of the element width. */
+template <size_t _Bits>
+struct width_holder {
+    constexpr explicit width_holder(size_t = _Bits) noexcept {}
+    constexpr static size_t width() { return _Bits; }
+};
+
+template <>
+struct width_holder <dynamic_width> {
+  private:
+    size_t bits;
+  public:
+    constexpr explicit width_holder(size_t __b) : bits(__b) {
+        if (__b == 0 || __b > __MaxBits)
+            throw std::invalid_argument("packed_vector: invalid width");
+    }
+    constexpr size_t width() const { return bits; }
+};
+
+} // namespace __detail::__packed
+
+
+/**
+ * @brief A vector of unsigned integers of _Bits bits each,
+ * packed back to back in the word storage of dynamic_bitset.
+ * Unused bits in the last word are kept 0, as in dynamic_bitset.
+ *
+ * With _Bits == dynamic_width, the width is given at construction.
+ */
+template <size_t _Bits = dynamic_width>
+struct packed_vector :
+    private __detail::__bitset::dynamic_storage <>,
+    private __detail::__packed::width_holder <_Bits> {
+  public:
+    using value_type = std::uint64_t;
+
+    static_assert(_Bits <= __detail::__packed::__MaxBits, "Width is too large.");
+
+  private:
+    using _Base_t  = __detail::__bitset::dynamic_storage <>;
+    using _Width_t = __detail::__packed::width_holder <_Bits>;
+    using _Word_t  = __detail::__packed::_Word_t;
+
+    /* Grow to __n bits, zeroing the newly used words. */
+    constexpr void grow(size_t __n) {
+        const auto __old = this->word_count();
+        const auto __new = __detail::__bitset::div_ceil(__n);
+        _Base_t::reserve(__new);
+        __detail::__bitset::word_reset(this->data() + __old, 0, __new - __old);
+        length = __n;
+    }
+
+  public:
+    /* ctor section. */
+
+    constexpr packed_vector() requires (_Bits != dynamic_width) = default;
+
+    /* Create __n zero elements. */
+    constexpr explicit packed_vector(size_t __n) requires (_Bits != dynamic_width)
+        : _Base_t(__n * _Bits, nullptr), _Width_t() {}
+
+    /* Create an empty vector of __b-bit elements. */
+    constexpr explicit packed_vector(std::nullptr_t, size_t __b)
+    requires (_Bits == dynamic_width) : _Base_t(), _Width_t(__b) {}
+
+    /* Create __n zero elements of __b bits. */
+    constexpr packed_vector(size_t __n, size_t __b) requires (_Bits == dynamic_width)
+        : _Base_t(), _Width_t(__b) { this->grow(__n * __b); }
+
+  public:
+    /* Function section. */
+
+    /* Bits of each element. */
+    constexpr size_t bits() const { return _Width_t::width(); }
+    constexpr size_t size() const { return length / this->bits(); }
+    constexpr bool  empty() const { return length == 0; }
+
+    /* Max value an element can hold. */
+    constexpr value_type max() const { return __detail::__packed::mask_bits(this->bits()); }
+
+    constexpr value_type get(size_t __n) const {
+        const auto __b = this->bits();
+        return __detail::__packed::get_bits(this->data(), __n * __b, __b);
+    }
+
+    /* Set the __n-th element. Bits beyond the width are ignored. */
+    constexpr void set(size_t __n, value_type __val) {
+        const auto __b = this->bits();
+        __detail::__packed::set_bits(this->data(), __n * __b, __b, __val & this->max());
+    }
+
+    constexpr value_type operator [] (size_t __n) const { return this->get(__n); }
+
+    constexpr value_type at(size_t __n) const {
+        if (__n >= this->size())
+            throw std::out_of_range("packed_vector::at");
+        return this->get(__n);
+    }
+
+    constexpr value_type front() const { return this->get(0); }
+    constexpr value_type back()  const { return this->get(this->size() - 1); }
+
+    constexpr void push_back(value_type __val) {
+        const auto __pos = length;
+        this->grow(__pos + this->bits());
+        __detail::__packed::set_bits(this->data(), __pos, this->bits(), __val & this->max());
+    }
+
+    constexpr void pop_back() noexcept {
+        length -= this->bits();
+        __detail::__bitset::validate(this->data(), length);
+    }
+
+    /* Resize to __n elements, new elements are 0. */
+    constexpr void resize(size_t __n) {
+        const auto __len = __n * this->bits();
+        if (__len > length) return this->grow(__len);
+        length = __len;
+        __detail::__bitset::validate(this->data(), length);
+    }
+
+    constexpr void clear() noexcept { length = 0; }
+
+    /* Reserve space for __n elements. */
+    constexpr void reserve(size_t __n) {
+        _Base_t::reserve(__detail::__bitset::div_ceil(__n * this->bits()));
+    }
+
+    /* Underlying words, unused bits in the last word are 0. */
+    using _Base_t::data;
+    using _Base_t::word_count;
+
+  public:
+    /* Bulk section. */
+
+    /**
+     * @brief Unpack elements [__first, __first + __out.size()) into __out.
+     * Whole blocks of 64 elements go through the width-specialized kernel.
+     */
+    template <std::unsigned_integral _Tp>
+    constexpr void unpack(std::span <_Tp> __out, size_t __first = 0) const {
+        using __detail::__packed::__WBits;
+        const auto __b   = this->bits();
+        const auto __end = __first + __out.size();
+        auto *__dst = __out.data();
+        size_t __cur = __first;
+
+        /* Head, until aligned to a block. */
+        for (; __cur != __end && __cur % __WBits != 0 ; ++__cur)
+            *__dst++ = static_cast <_Tp> (this->get(__cur));
+
+        if (std::is_constant_evaluated()) {
+            for (; __cur != __end ; ++__cur)
+                *__dst++ = static_cast <_Tp> (this->get(__cur));
+            return;
+        }
+
+        const auto __fn = __detail::__packed::get_unpack <_Bits, _Tp> (__b);
+        for (; __end - __cur >= __WBits ; __cur += __WBits, __dst += __WBits)
+            __fn(this->data() + (__cur / __WBits) * __b, __dst);
+
+        /* Tail. */
+        for (; __cur != __end ; ++__cur)
+            *__dst++ = static_cast <_Tp> (this->get(__cur));
+    }
+
+    /**
+     * @brief Append all elements of __in.
+     * Bits beyond the width are ignored.
+     */
+    template <std::unsigned_integral _Tp>
+    constexpr void append(std::span <const _Tp> __in) {
+        using __detail::__packed::__WBits;
+        const auto __b   = this->bits();
+        const auto *__src = __in.data();
+        const auto *__end = __src + __in.size();
+
+        this->reserve(this->size() + __in.size());
+
+        /* Head, until aligned to a block. */
+        for (; __src != __end && this->size() % __WBits != 0 ; ++__src)
+            this->push_back(*__src);
+
+        if (!std::is_constant_evaluated()) {
+            const auto __fn = __detail::__packed::get_pack <_Bits, _Tp> (__b);
+            while (__end - __src >= ptrdiff_t(__WBits)) {
+                const auto __pos = this->size();
+                length += __WBits * __b; // Whole words, no need to zero.
+                __fn(__src, this->data() + (__pos / __WBits) * __b);
+                __src += __WBits;
+            }
+        }
+
+        /* Tail. */
+        for (; __src != __end ; ++__src) this->push_back(*__src);
+    }
+};
+
+
+} // namespace dark
@@ -0,0 +1,266 @@
+#pragma once
+#include "bitset.h"
+#include <bit>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
+namespace dark {
+
+
+namespace __detail::__snapshot {
+
+using __bitset::_Word_t;
+using __bitset::__WBits;
+
+/* Words in one page, 4 KiB. */
+inline constexpr size_t __PWords = 512;
+/* Bits in one page. */
+inline constexpr size_t __PBits  = __PWords * __WBits;
+
+/* A fixed-size page of words. */
+struct page {
+    _Word_t words[__PWords] = {};
+};
+
+using page_ptr = std::shared_ptr <page>;
+
+/**
+ * The shared all-zero page. New pages point here until written,
+ * so growing allocates nothing, and the first write copies.
+ */
+inline const page_ptr &zero_page() {
+    static const page_ptr __zero = std::make_shared <page> ();
+    return __zero;
+}
+
+/* Return the page index and the bit offset in that page. */
+inline constexpr auto page_of(size_t __n) {
+    struct {
+        size_t div;
+        size_t mod;
+    } __ret = { __n / __PBits, __n % __PBits };
+    return __ret;
+}
+
+/* Return ceiling of __n / __PBits. */
+inline constexpr size_t page_ceil(size_t __n) {
+    return (__n + __PBits - 1) / __PBits;
+}
+
+/* A page table with the length, the root of one version. */
+struct root {
+    std::vector <page_ptr>  pages;
+    size_t                  length = 0;
+
+    bool test(size_t __n) const {
+        const auto [__div, __mod] = page_of(__n);
+        const auto [__wid, __bit] = __bitset::div_mod(__mod);
+        return (pages[__div]->words[__wid] >> __bit) & 1;
+    }
+
+    size_t count() const {
+        size_t __cnt = 0;
+        for (const auto &__page : pages)
+            for (const auto __word : __page->words)
+                __cnt += std::popcount(__word);
+        return __cnt;
+    }
+
+    bool none() const {
+        for (const auto &__page : pages)
+            for (const auto __word : __page->words)
+                if (__word != 0) return false;
+        return true;
+    }
+};
+
+} // namespace __detail::__snapshot
+
+
+/**
+ * @brief A bitset with one writer and many concurrent readers.
+ * Words live in reference-counted pages of 4 KiB. A snapshot shares
+ * the pages of the version published last, so taking it is O(1), and
+ * the writer copies a page only the first time it writes that page
+ * while the page is shared (copy-on-write).
+ *
+ * Only one thread may call the non-const member functions at a time.
+ * snapshot() may be called from any thread, and a snapshot stays valid
+ * and unchanged for as long as it is held.
+ *
+ * As in dynamic_bitset, bits beyond the length are kept 0.
+ */
+struct snapshot_bitset {
+  private:
+    using _Word_t = __detail::__snapshot::_Word_t;
+    using _Root_t = __detail::__snapshot::root;
+
+  public:
+    /* A read-only, immutable version of the bitset. */
+    struct view {
+      private:
+        std::shared_ptr <const _Root_t> ptr;
+
+        friend struct snapshot_bitset;
+        explicit view(std::shared_ptr <const _Root_t> __ptr) noexcept : ptr(std::move(__ptr)) {}
+
+      public:
+        size_t size()  const { return ptr->length; }
+        bool   empty() const { return ptr->length == 0; }
+
+        bool test(size_t __n) const { return ptr->test(__n); }
+        bool operator [] (size_t __n) const { return ptr->test(__n); }
+        bool at(size_t __n) const {
+            if (__n >= ptr->length)
+                throw std::out_of_range("snapshot_bitset::view::at");
+            return ptr->test(__n);
+        }
+
+        /* Return the number of bits set to 1. */
+        size_t count() const { return ptr->count(); }
+        /* Return whether there is any bit set to 1. */
+        bool any()  const { return !ptr->none(); }
+        /* Return whether all bits are set to 0. */
+        bool none() const { return ptr->none(); }
+
+        /* Copy the bits into a plain dynamic_bitset. */
+        dynamic_bitset to_bitset() const {
+            using namespace __detail::__snapshot;
+            dynamic_bitset __ret(ptr->length);
+            const auto __size = __ret.word_count();
+            for (size_t i = 0 ; i < __size ; i += __PWords) {
+                const auto __n = std::min(__PWords, __size - i);
+                __detail::__bitset::word_copy(__ret.data() + i, ptr->pages[i / __PWords]->words, __n);
+            }
+            return __ret;
+        }
+    };
+
+  private:
+    _Root_t                                     work;       // Version of the writer
+    std::atomic <std::shared_ptr <const _Root_t>> published;  // Version of the readers
+
+    /* Return the words of page __n, copying the page if shared. */
+    _Word_t *page_data(size_t __n) {
+        auto &__page = work.pages[__n];
+        if (__page.use_count() != 1) {
+            __page = std::make_shared <__detail::__snapshot::page> (*__page);
+        } else {
+            /* Pair with the release when the last reader drops the page. */
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return __page->words;
+    }
+
+    /* Return the word holding bit __n for writing. */
+    _Word_t &word_of(size_t __n) {
+        const auto [__div, __mod] = __detail::__snapshot::page_of(__n);
+        return this->page_data(__div)[__mod / __detail::__snapshot::__WBits];
+    }
+
+    /* Return the mask of bit __n in its word. */
+    static constexpr _Word_t mask_of(size_t __n) {
+        return __detail::__bitset::mask_pos(__n % __detail::__snapshot::__WBits);
+    }
+
+    /* Clear the bits from __n to the end of its page. */
+    void validate(size_t __n) {
+        using namespace __detail::__snapshot;
+        const auto [__div, __mod] = page_of(__n);
+        if (__mod == 0) return;
+        const auto [__wid, __bit] = __detail::__bitset::div_mod(__mod);
+        const auto *__old = work.pages[__div]->words;
+        bool __dirty = __bit != 0 && (__old[__wid] >> __bit) != 0;
+        for (size_t i = __wid + (__bit != 0) ; i != __PWords && !__dirty ; ++i)
+            __dirty = __old[i] != 0;
+        if (!__dirty) return; // Avoid a needless page copy.
+        auto *__words = this->page_data(__div);
+        __words[__wid] &= __detail::__bitset::mask_low(__bit);
+        __detail::__bitset::word_reset(__words + __wid + 1, 0, __PWords - __wid - 1);
+    }
+
+  public:
+    /* ctor section. */
+
+    snapshot_bitset() { this->publish(); }
+
+    /* Create __n bits of 0. */
+    explicit snapshot_bitset(size_t __n) { this->resize(__n); this->publish(); }
+
+    /* Create from a dynamic_bitset. */
+    explicit snapshot_bitset(const dynamic_bitset &__src) {
+        using namespace __detail::__snapshot;
+        this->resize(__src.size());
+        const auto __size = __src.word_count();
+        for (size_t i = 0 ; i < __size ; i += __PWords) {
+            const auto __n = std::min(__PWords, __size - i);
+            __detail::__bitset::word_copy(this->page_data(i / __PWords), __src.data() + i, __n);
+        }
+        this->publish();
+    }
+
+    /* Shared by the readers, so it cannot be copied or moved. */
+    snapshot_bitset(const snapshot_bitset &) = delete;
+    snapshot_bitset &operator = (const snapshot_bitset &) = delete;
+
+  public:
+    /* Section of the readers, safe from any thread. */
+
+    /* Return the version published last, in O(1). */
+    view snapshot() const { return view { published.load(std::memory_order_acquire) }; }
+
+  public:
+    /* Section of the writer. */
+
+    /**
+     * @brief Publish the current bits as the version seen by snapshot().
+     * It copies the page table but no page. Pages written after this
+     * are copied once, and the old version is freed with its last view.
+     */
+    void publish() {
+        published.store(std::make_shared <const _Root_t> (work), std::memory_order_release);
+    }
+
+    size_t size()  const { return work.length; }
+    bool   empty() const { return work.length == 0; }
+
+    bool test(size_t __n) const { return work.test(__n); }
+    bool operator [] (size_t __n) const { return work.test(__n); }
+
+    size_t count() const { return work.count(); }
+    bool any()  const { return !work.none(); }
+    bool none() const { return work.none(); }
+
+    void set(size_t __n)    { this->word_of(__n) |=  this->mask_of(__n); }
+    void reset(size_t __n)  { this->word_of(__n) &= ~this->mask_of(__n); }
+    void flip(size_t __n)   { this->word_of(__n) ^=  this->mask_of(__n); }
+    void set(size_t __n, bool __x) { __x ? this->set(__n) : this->reset(__n); }
+
+    /* Resize to __n bits, new bits are 0. */
+    void resize(size_t __n) {
+        using namespace __detail::__snapshot;
+        if (__n < work.length) {
+            work.pages.resize(page_ceil(__n));
+            work.length = __n;
+            this->validate(__n);
+        } else {
+            work.pages.resize(page_ceil(__n), zero_page());
+            work.length = __n;
+        }
+    }
+
+    void push_back(bool __x) {
+        const auto __pos = work.length;
+        this->resize(__pos + 1);
+        if (__x) this->set(__pos);
+    }
+
+    void pop_back() { this->resize(work.length - 1); }
+    void clear()    { this->resize(0); }
+};
+
+
+} // namespace dark
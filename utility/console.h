@@ -1,5 +1,5 @@
-#include <iostream>
-#include <format>
+#pragma once
+#include "logger.h"
 
 namespace dark::console {
 
@@ -14,10 +14,15 @@ enum class Color : int {
     WHITE   = 37,
 };
 
-/* Atomic colored print function. */
+/**
+ * Atomic colored print function, written by the background logger.
+ * Pending messages are still written if the program aborts.
+ */
 inline static void print(std::string_view __msg, Color __color) {
-    std::cerr << std::format("\033[1;{}m{}\033[0m\n",
-        static_cast <int> (__color), __msg);
+    return logging::log(static_cast <int> (__color), __msg);
 }
 
+/* Wait until everything printed before is written. */
+inline static void flush() { logging::flush(); }
+
 } // namespace dark::console
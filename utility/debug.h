@@ -24,6 +24,8 @@ using normal    = __detail::__debug::printer <console::Color::GREEN>;
 
 [[noreturn]] inline void panic_handler(
     std::string_view __msg, std::source_location __loc) {
+    /* Make room first, so the message is not dropped on overflow. */
+    console::flush();
     error { std::format("Panic at {}:{}:{}: {}",
         __loc.file_name(),
         __loc.line(),
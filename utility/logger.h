@@ -0,0 +1,421 @@
+#pragma once
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <format>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <iostream>
+#include <exception>
+#include <string_view>
+#include <type_traits>
+#include <condition_variable>
+
+namespace dark::logging {
+
+/* What a thread does when its ring buffer is full. */
+enum class overflow : int {
+    block,  // Wait for the background thread (backpressure)
+    drop,   // Drop the record and count it
+};
+
+namespace __detail::__logging {
+
+/* Size of a cache line, to keep producer and consumer apart. */
+inline constexpr std::size_t __Line = 64;
+/* Size of one record. */
+inline constexpr std::size_t __Record = 256;
+/* Records in one per-thread ring, must be a power of 2. */
+inline constexpr std::size_t __Capacity = 256;
+/* How long the background thread sleeps when there is nothing to do. */
+inline constexpr auto __Interval = std::chrono::milliseconds(1);
+/* How long a crashing program waits for pending messages at most. */
+inline constexpr auto __Grace = std::chrono::seconds(1);
+
+struct record;
+
+/* Append the text of a record to the output. */
+using format_fn = void (*)(std::string &, const record &);
+
+/* A fixed-size log record: plain text, heap text or deferred format. */
+struct record {
+    format_fn       fn;     // How to turn the payload into text
+    int             color;  // ANSI color code, 0 for none
+    std::uint32_t   size;   // Bytes of the payload in use
+    alignas(8) std::byte payload[__Record - 16];
+};
+
+static_assert(sizeof(record) == __Record);
+
+inline constexpr std::size_t __Payload = sizeof(record::payload);
+
+/* Arguments that can be formatted later on another thread. */
+template <class _Tp>
+concept deferrable = std::is_arithmetic_v <std::decay_t <_Tp>>;
+
+/* Payload of a deferred record. */
+template <class ..._Args>
+struct deferred {
+    std::string_view                fmt;
+    std::tuple <std::decay_t <_Args>...> args;
+};
+
+/* Payload of a message too long for one record, freed once written. */
+struct heap_text {
+    char           *data;
+    std::size_t     size;
+};
+
+inline void format_text(std::string &__out, const record &__rec) {
+    __out.append(reinterpret_cast <const char *> (__rec.payload), __rec.size);
+}
+
+inline void format_heap(std::string &__out, const record &__rec) {
+    const auto &__val = *std::launder(reinterpret_cast <const heap_text *> (__rec.payload));
+    __out.append(__val.data, __val.size);
+    delete[] __val.data;
+}
+
+template <class ..._Args>
+inline void format_deferred(std::string &__out, const record &__rec) {
+    const auto &__val = *std::launder(reinterpret_cast <const deferred <_Args...> *> (__rec.payload));
+    std::apply([&](const auto &...__args) {
+        std::vformat_to(std::back_inserter(__out), __val.fmt, std::make_format_args(__args...));
+    }, __val.args);
+}
+
+/* Single-producer single-consumer ring of records. */
+struct ring {
+    alignas(__Line) std::atomic <std::size_t> tail {0};     // Written by the producer
+    alignas(__Line) std::atomic <std::size_t> head {0};     // Written by the consumer
+    alignas(__Line) std::atomic <std::size_t> dropped {0};  // Records dropped
+    std::atomic <bool> retired {false}; // Whether the producer thread exits
+    record slots[__Capacity];
+
+    /* Return a free slot, or nullptr if full. */
+    record *reserve() {
+        const auto __t = tail.load(std::memory_order_relaxed);
+        if (__t - head.load(std::memory_order_acquire) == __Capacity) return nullptr;
+        return &slots[__t % __Capacity];
+    }
+
+    /* Publish the slot returned by reserve(). */
+    void commit() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /* Consume all the records. Return the count consumed. */
+    std::size_t drain(std::string &__out) {
+        auto __h = head.load(std::memory_order_relaxed);
+        const auto __t = tail.load(std::memory_order_acquire);
+        const auto __n = __t - __h;
+        for (; __h != __t ; ++__h) {
+            const auto &__rec = slots[__h % __Capacity];
+            if (__rec.color != 0) std::format_to(std::back_inserter(__out), "\033[1;{}m", __rec.color);
+            __rec.fn(__out, __rec);
+            __out.append(__rec.color != 0 ? "\033[0m\n" : "\n");
+        }
+        head.store(__t, std::memory_order_release);
+        return __n;
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * The logging backend. Every thread writes to its own ring,
+ * and a background thread drains all rings in one batched write.
+ * The hot path takes no lock: the mutex only guards the ring list.
+ *
+ * It is never destroyed, so logging stays safe in destructors of
+ * static objects. At exit it drains everything and gets closed,
+ * and from then on every message is written synchronously.
+ */
+struct backend {
+  private:
+    std::mutex                          mtx;        // Guard of rings
+    std::vector <std::unique_ptr <ring>> rings;     // All the rings
+    std::condition_variable             cond;       // Wakes the background thread
+    std::atomic <std::uint64_t>         requested {0};  // Flush requests
+    std::atomic <std::uint64_t>         completed {0};  // Flush requests served
+    std::atomic <bool>                  stalled  {false};   // Some producer finds its ring full
+    std::atomic <bool>                  stopping {false};
+    std::atomic <bool>                  closed   {false};
+    std::atomic <overflow>              policy {overflow::block};
+    std::thread                         worker;
+
+    /* Drain every ring once, then write the batch. */
+    std::size_t drain_all(std::string &__out) {
+        std::size_t __cnt = 0;
+        {
+            std::lock_guard __lock { mtx };
+            for (auto __it = rings.begin() ; __it != rings.end() ;) {
+                auto &__ring = **__it;
+                const bool __retired = __ring.retired.load(std::memory_order_acquire);
+                __cnt += __ring.drain(__out);
+                if (const auto __n = __ring.dropped.exchange(0))
+                    std::format_to(std::back_inserter(__out), "[logger] {} records dropped\n", __n);
+                if (__retired && __ring.empty()) __it = rings.erase(__it);
+                else ++__it;
+            }
+        }
+        if (!__out.empty()) {
+            std::cerr.write(__out.data(), __out.size());
+            std::cerr.flush();
+            __out.clear();
+        }
+        return __cnt;
+    }
+
+    void run() {
+        std::string __buf;
+        while (true) {
+            const auto __req  = requested.load();
+            const bool __stop = stopping.load();
+            stalled.store(false);
+            const auto __cnt  = this->drain_all(__buf);
+            completed.store(__req);
+            completed.notify_all();
+            if (__cnt != 0) continue;
+            if (__stop) break;
+            std::unique_lock __lock { mtx };
+            cond.wait_for(__lock, __Interval, [&] {
+                return requested.load() != __req || stopping.load() || stalled.load();
+            });
+        }
+    }
+
+    /**
+     * Set a flag the background thread waits on, then wake it.
+     * The flag is set under the mutex, so the wake-up cannot fall
+     * between the check of the predicate and the wait.
+     */
+    template <class _Fn>
+    void wake(_Fn &&__fn) {
+        { std::lock_guard __lock { mtx }; __fn(); }
+        cond.notify_one();
+    }
+
+  public:
+    backend() : worker([this] { this->run(); }) {}
+
+    /* Drain all the records and stop the background thread. */
+    void close() {
+        if (closed.load()) return;
+        stopping.store(true);
+        cond.notify_one();
+        worker.join();
+        closed.store(true);
+        /* Release any flush() that raced with the last drain. */
+        completed.store(UINT64_MAX);
+        completed.notify_all();
+    }
+
+    bool is_closed() const { return closed.load(std::memory_order_acquire); }
+
+    /* Create a ring for the calling thread. */
+    ring *attach() {
+        auto __ptr = std::make_unique <ring> ();
+        auto *__raw = __ptr.get();
+        std::lock_guard __lock { mtx };
+        rings.push_back(std::move(__ptr));
+        return __raw;
+    }
+
+    /**
+     * Wait until every record pushed before is written.
+     * It returns at once when closed, or on the background thread,
+     * where waiting would never end.
+     */
+    void flush() {
+        if (this->is_closed() || std::this_thread::get_id() == worker.get_id()) return;
+        std::uint64_t __req;
+        this->wake([&] { __req = ++requested; });
+        auto __cur = completed.load();
+        while (__cur < __req) {
+            completed.wait(__cur);
+            __cur = completed.load();
+        }
+    }
+
+    /**
+     * Best-effort flush for a crashing program. It takes no lock, so it
+     * cannot hang on a lock held by the crashing thread, and it gives up
+     * after __Grace. A lost wake-up only costs one __Interval.
+     */
+    void try_flush() {
+        if (this->is_closed() || std::this_thread::get_id() == worker.get_id()) return;
+        const auto __req = ++requested;
+        cond.notify_one();
+        const auto __end = std::chrono::steady_clock::now() + __Grace;
+        while (completed.load() < __req && std::chrono::steady_clock::now() < __end)
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    void set_policy(overflow __p) { policy.store(__p, std::memory_order_relaxed); }
+
+    /* Return a free slot in __ring, waiting or dropping as configured. */
+    record *reserve(ring &__ring) {
+        while (true) {
+            if (auto *__rec = __ring.reserve()) return __rec;
+            if (policy.load(std::memory_order_relaxed) == overflow::drop) {
+                __ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            this->wake([this] { stalled.store(true); });
+            std::this_thread::yield();
+        }
+    }
+};
+
+/* The terminate handler before ours. */
+inline std::terminate_handler prev_terminate = nullptr;
+
+/* The SIGABRT handler before ours. */
+inline void (*prev_abort)(int) = SIG_DFL;
+
+/* Write out pending messages before the program dies. */
+[[noreturn]] inline void on_terminate();
+inline void on_abort(int);
+
+/* The backend, leaked on purpose, and closed at exit. */
+inline backend &instance() {
+    static backend *const __inst = [] {
+        auto *__ptr = new backend;
+        std::atexit([] { instance().close(); });
+        prev_terminate = std::set_terminate(on_terminate);
+        if (auto __prev = std::signal(SIGABRT, on_abort); __prev != SIG_ERR)
+            prev_abort = __prev;
+        return __ptr;
+    } ();
+    return *__inst;
+}
+
+[[noreturn]] inline void on_terminate() {
+    instance().try_flush();
+    if (prev_terminate != nullptr) prev_terminate();
+    std::abort();
+}
+
+/* Flush, then hand the signal to the handler before ours. */
+inline void on_abort(int __sig) {
+    instance().try_flush();
+    std::signal(__sig, prev_abort);
+    std::raise(__sig);
+}
+
+/* Whether the ring of the calling thread is retired. */
+inline thread_local bool detached = false;
+
+/* Ring of the calling thread, retired when the thread exits. */
+struct ring_handle {
+    ring *ptr;
+    ring_handle() : ptr(instance().attach()) {}
+    ~ring_handle() {
+        detached = true;
+        ptr->retired.store(true, std::memory_order_release);
+    }
+};
+
+/* Ring of the calling thread, or nullptr if it must write synchronously. */
+inline ring *local_ring() {
+    if (detached || instance().is_closed()) return nullptr;
+    thread_local ring_handle __handle;
+    return __handle.ptr;
+}
+
+/**
+ * Write a message on the calling thread, keeping the order.
+ * Only used when the ring is gone: during exit, or in the
+ * thread-local destructors of a thread that exits.
+ */
+inline void write_sync(int __color, std::string_view __msg) {
+    instance().flush();
+    if (__color != 0)
+        std::cerr << std::format("\033[1;{}m{}\033[0m\n", __color, __msg);
+    else
+        std::cerr << std::format("{}\n", __msg);
+}
+
+} // namespace __detail::__logging
+
+
+/**
+ * @brief Log a preformatted message with an ANSI color (0 for none).
+ * The message is copied into the ring of the calling thread and
+ * written later by the background thread. Messages too long for
+ * one record are copied to the heap instead. Only messages logged
+ * during exit are written synchronously.
+ */
+inline void log(int __color, std::string_view __msg) {
+    using namespace __detail::__logging;
+    auto *__ring = local_ring();
+    if (__ring == nullptr) return write_sync(__color, __msg);
+    auto *__rec  = instance().reserve(*__ring);
+    if (__rec == nullptr) return;
+    __rec->color = __color;
+    if (__msg.size() <= __Payload) {
+        __rec->fn   = format_text;
+        __rec->size = static_cast <std::uint32_t> (__msg.size());
+        std::memcpy(__rec->payload, __msg.data(), __msg.size());
+    } else {
+        auto *__buf = new char[__msg.size()];
+        std::memcpy(__buf, __msg.data(), __msg.size());
+        __rec->fn   = format_heap;
+        __rec->size = sizeof(heap_text);
+        ::new (__rec->payload) heap_text { __buf, __msg.size() };
+    }
+    __ring->commit();
+}
+
+/**
+ * @brief Log a message synchronously, after all pending messages.
+ * It blocks until the background thread catches up, so prefer log().
+ * Pending messages are flushed anyway on abort and std::terminate.
+ */
+inline void log_sync(int __color, std::string_view __msg) {
+    return __detail::__logging::write_sync(__color, __msg);
+}
+
+/**
+ * @brief Log a message in std::format syntax.
+ * If all arguments are arithmetic, formatting is deferred to the
+ * background thread, so the caller only copies the arguments.
+ * Otherwise the message is formatted on the calling thread.
+ */
+template <class ..._Args>
+inline void log(int __color, std::format_string <_Args...> __fmt, _Args &&...__args) {
+    using namespace __detail::__logging;
+    using _Deferred_t = deferred <_Args...>;
+    if constexpr ((deferrable <_Args> && ...)
+        && sizeof(_Deferred_t) <= __Payload && alignof(_Deferred_t) <= 8) {
+        if (auto *__ring = local_ring()) {
+            auto *__rec  = instance().reserve(*__ring);
+            if (__rec == nullptr) return;
+            __rec->fn    = format_deferred <_Args...>;
+            __rec->color = __color;
+            __rec->size  = sizeof(_Deferred_t);
+            ::new (__rec->payload) _Deferred_t { __fmt.get(), { __args... } };
+            return __ring->commit();
+        }
+    }
+    return log(__color, std::string_view {
+        std::format(__fmt, std::forward <_Args> (__args)...)
+    });
+}
+
+/* Wait until every message logged before is written. */
+inline void flush() { __detail::__logging::instance().flush(); }
+
+/* Choose what to do when a thread logs faster than it is written. */
+inline void set_overflow(overflow __p) { __detail::__logging::instance().set_policy(__p); }
+
+} // namespace dark::logging
@@ -1,5 +1,13 @@
 #pragma once
 #include "basic.h"
+#include <bit>
+#include <array>
+#include <tuple>
+#include <limits>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <functional>
 #include <string_view>
 #include <source_location>
 
@@ -81,6 +89,236 @@ inline constexpr static struct remove_scope_t {
 constexpr auto operator | (remove_scope_t, std::string_view name) { return remove_scope(name); }
 constexpr auto operator | (std::string_view name, remove_scope_t) { return remove_scope(name); }
 
+/**
+ * Range of values scanned by enum reflection, [min, max].
+ * Specialize it for enums whose enumerators lie out of the default range.
+ */
+template <class _Enum>
+struct enum_range {
+    static constexpr long long min = -128;
+    static constexpr long long max = 127;
+};
+
+namespace __detail::__meta {
+
+/* Name of an enumerator without scopes, or empty if _Val is not named. */
+template <class _Enum, long long _Val>
+consteval std::string_view enum_name() {
+    const auto name = value_string <static_cast <_Enum> (_Val)> ();
+    if (name.empty() || name.front() == '(') return {};
+    if (name.front() == '-' || (name.front() >= '0' && name.front() <= '9')) return {};
+    return name | remove_scope;
+}
+
+/* Scanned range of an enum, clamped to its underlying type. */
+template <class _Enum>
+consteval auto enum_bounds() {
+    using _Tp = std::underlying_type_t <_Enum>;
+    using _Lim = std::numeric_limits <_Tp>;
+    struct { long long min, max; } __ret = { enum_range <_Enum>::min, enum_range <_Enum>::max };
+    /* Unary + promotes char types, which std::cmp_less does not take. */
+    if (std::cmp_greater(+_Lim::min(), __ret.min)) __ret.min = _Lim::min();
+    if (std::cmp_less(+_Lim::max(), __ret.max)) __ret.max = _Lim::max();
+    return __ret;
+}
+
+template <class _Enum, long long _Min, long long ..._Idx>
+consteval auto make_enum_names(std::integer_sequence <long long, _Idx...>) {
+    return std::array <std::string_view, sizeof...(_Idx)> { enum_name <_Enum, _Min + _Idx> ()... };
+}
+
+/* FNV-1a with a seed. */
+inline constexpr std::uint64_t hash(std::string_view __str, std::uint64_t __seed) {
+    std::uint64_t __h = 0xcbf29ce484222325ULL ^ (__seed * 0x9e3779b97f4a7c15ULL);
+    for (const char __c : __str) {
+        __h ^= static_cast <unsigned char> (__c);
+        __h *= 0x100000001b3ULL;
+    }
+    return __h ^ (__h >> 29);
+}
+
+struct hash_param { std::uint64_t seed; std::size_t size; };
+
+/**
+ * Find a seed and a power-of-2 table size, so that the given
+ * keys hash to distinct slots. The table grows if no seed in
+ * a few tries works. Duplicate keys fail at compile time.
+ */
+template <std::size_t _Nm>
+consteval hash_param find_hash(const std::array <std::string_view, _Nm> &__keys) {
+    constexpr std::size_t __Init = std::bit_ceil(_Nm * 2 + 1);
+    constexpr std::size_t __Max  = __Init * 16;
+    for (std::size_t __size = __Init ; __size <= __Max ; __size <<= 1) {
+        for (std::uint64_t __seed = 0 ; __seed != 256 ; ++__seed) {
+            std::array <bool, __Max> __used {};
+            bool __ok = true;
+            for (std::size_t i = 0 ; i != _Nm && __ok ; ++i) {
+                auto &__slot = __used[hash(__keys[i], __seed) & (__size - 1)];
+                __ok = !__slot;
+                __slot = true;
+            }
+            if (__ok) return { __seed, __size };
+        }
+    }
+    throw "meta: no perfect hash found, are the keys distinct?";
+}
+
+/**
+ * A compile-time perfect hash from _Nm distinct keys to their index.
+ * Lookup costs one hash of the input and one string compare.
+ */
+template <std::size_t _Nm, hash_param _Param>
+struct perfect_hash {
+    inline static constexpr std::size_t npos = -1;
+
+    std::array <std::string_view, _Nm>          keys;
+    std::array <std::uint16_t, _Param.size>     slots {}; // Index + 1, 0 for empty
+
+    consteval explicit perfect_hash(const std::array <std::string_view, _Nm> &__keys) : keys(__keys) {
+        static_assert(_Nm < 65535, "Too many keys.");
+        for (std::size_t i = 0 ; i != _Nm ; ++i)
+            slots[hash(keys[i], _Param.seed) & (_Param.size - 1)] = i + 1;
+    }
+
+    /* Index of the key, or npos. */
+    constexpr std::size_t find(std::string_view __str) const {
+        const std::size_t __idx = slots[hash(__str, _Param.seed) & (_Param.size - 1)];
+        if (__idx == 0 || keys[__idx - 1] != __str) return npos;
+        return __idx - 1;
+    }
+};
+
+/* Build a perfect hash from a constant array of keys. */
+template <const auto &_Keys>
+consteval auto make_perfect_hash() {
+    return perfect_hash <_Keys.size(), find_hash(_Keys)> { _Keys };
+}
+
+/* Reflection data of an enum, all computed at compile time. */
+template <class _Enum>
+struct enum_info {
+    inline static constexpr auto bounds = enum_bounds <_Enum> ();
+
+    /* Name of every value in the range, indexed by (value - min). */
+    inline static constexpr auto table = make_enum_names <_Enum, bounds.min>
+        (std::make_integer_sequence <long long, bounds.max - bounds.min + 1> {});
+
+    inline static constexpr std::size_t count = [] {
+        std::size_t __cnt = 0;
+        for (const auto __name : table) __cnt += !__name.empty();
+        return __cnt;
+    } ();
+
+    /* Named values in ascending order, and their names. */
+    inline static constexpr auto values = [] {
+        std::array <_Enum, count> __ret {};
+        std::size_t __cnt = 0;
+        for (std::size_t i = 0 ; i != table.size() ; ++i)
+            if (!table[i].empty())
+                __ret[__cnt++] = static_cast <_Enum> (bounds.min + static_cast <long long> (i));
+        return __ret;
+    } ();
+
+    inline static constexpr auto names = [] {
+        std::array <std::string_view, count> __ret {};
+        std::size_t __cnt = 0;
+        for (const auto __name : table)
+            if (!__name.empty()) __ret[__cnt++] = __name;
+        return __ret;
+    } ();
+
+    inline static constexpr auto lookup = make_perfect_hash <names> ();
+};
+
+/* Reflection data of a list of types. */
+template <class ..._Tp>
+struct type_info {
+    inline static constexpr std::array <std::string_view, sizeof...(_Tp)>
+        names = { type_string <_Tp> ()... };
+
+    inline static constexpr auto lookup = make_perfect_hash <names> ();
+};
+
+} // namespace __detail::__meta
+
+/* All named values of an enum in the scanned range, in ascending order. */
+template <class _Enum>
+inline constexpr auto &enum_values = __detail::__meta::enum_info <_Enum>::values;
+
+/* Names of enum_values <_Enum>, without scopes. */
+template <class _Enum>
+inline constexpr auto &enum_names = __detail::__meta::enum_info <_Enum>::names;
+
+/**
+ * @brief Name of an enum value without scopes, in O(1) by table lookup.
+ * @return Empty string if the value is not named or out of the range.
+ */
+template <class _Enum>
+requires std::is_enum_v <_Enum>
+constexpr std::string_view to_string(_Enum __val) {
+    using _Info = __detail::__meta::enum_info <_Enum>;
+    const auto __num = static_cast <long long> (__val);
+    if (__num < _Info::bounds.min || __num > _Info::bounds.max) return {};
+    return _Info::table[__num - _Info::bounds.min];
+}
+
+/**
+ * @brief Enum value of a name without scopes, by compile-time perfect hash.
+ * @return nullopt if no enumerator has that name.
+ */
+template <class _Enum>
+requires std::is_enum_v <_Enum>
+constexpr std::optional <_Enum> from_string(std::string_view __str) {
+    using _Info = __detail::__meta::enum_info <_Enum>;
+    const auto __idx = _Info::lookup.find(__str);
+    if (__idx == _Info::lookup.npos) return std::nullopt;
+    return _Info::values[__idx];
+}
+
+/**
+ * @brief A dispatch table over a list of types, keyed by type_string.
+ * Lookup by name uses a compile-time perfect hash, and visit calls
+ * through a constant table of function pointers.
+ */
+template <class ..._Tp>
+struct type_table {
+  private:
+    using _Info = __detail::__meta::type_info <_Tp...>;
+
+  public:
+    inline static constexpr std::size_t size = sizeof...(_Tp);
+    inline static constexpr std::size_t npos = -1;
+
+    /* Names of the types, as type_string gives. */
+    inline static constexpr auto &names = _Info::names;
+
+    /* Index of a type by its name, or npos. */
+    static constexpr std::size_t index_of(std::string_view __name) {
+        return _Info::lookup.find(__name);
+    }
+
+    /* Index of a type in the list. */
+    template <class _Up>
+    static constexpr std::size_t index_of() {
+        return index_of(type_string <_Up> ());
+    }
+
+    /**
+     * @brief Call __fn(std::type_identity <T> {}) with the __n-th type T.
+     * All the calls must return the same type. __n must be less than size.
+     */
+    template <class _Fn>
+    requires (sizeof...(_Tp) != 0)
+    static constexpr decltype(auto) visit(std::size_t __n, _Fn &&__fn) {
+        using _First = std::tuple_element_t <0, std::tuple <_Tp...>>;
+        using _Ret = std::invoke_result_t <_Fn &, std::type_identity <_First>>;
+        constexpr _Ret (*__table[])(_Fn &) = {
+            [](_Fn &__f) -> _Ret { return std::invoke(__f, std::type_identity <_Tp> {}); }...
+        };
+        return __table[__n](__fn);
+    }
+};
+
 } // namespace dark
 
 /**
@@ -0,0 +1,388 @@
+#pragma once
+#include "debug.h"
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <source_location>
+
+namespace dark::debug {
+
+namespace __detail::__trace {
+
+/* Buckets of the duration histogram, bucket i holds [2^i, 2^(i+1)) ns. */
+inline constexpr std::size_t __Buckets = 64;
+
+} // namespace __detail::__trace
+
+/* Aggregated durations of one call site. */
+struct trace_site {
+    std::source_location    loc;
+    const char *            name;
+    std::uint64_t           count = 0;
+    std::uint64_t           total = 0;          // ns
+    std::uint64_t           min   = UINT64_MAX; // ns
+    std::uint64_t           max   = 0;          // ns
+    std::uint64_t           histogram[__detail::__trace::__Buckets] = {};
+};
+
+} // namespace dark::debug
+
+#if defined(_DEBUG) && !defined(_RELEASE)
+#include <bit>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <deque>
+#include <atomic>
+#include <format>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace dark::debug {
+
+namespace __detail::__trace {
+
+/* Events in one chunk of a thread buffer. */
+inline constexpr std::size_t __Chunk = 4096;
+/* Bits of the site id in an event. */
+inline constexpr std::size_t __SiteBits = 24;
+/* Max duration of an event in ticks, longer spans saturate. */
+inline constexpr std::uint64_t __MaxTicks = (std::uint64_t{1} << (64 - __SiteBits)) - 1;
+
+/* Read the timestamp counter, or the steady clock if there is none. */
+[[__gnu__::__always_inline__]]
+inline std::uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+inline std::uint64_t steady_ns() {
+    using namespace std::chrono;
+    return duration_cast <nanoseconds> (steady_clock::now().time_since_epoch()).count();
+}
+
+/* Where a span is created. */
+struct site {
+    std::source_location    loc;    // Where the span is created
+    const char *            name;   // Custom name, or nullptr for the function name
+};
+
+/**
+ * One finished span, 16 bytes. The duration in ticks and the site id
+ * share one word: 40 bits of ticks (minutes at GHz rates) and 24 bits
+ * of site id.
+ */
+struct event {
+    std::uint64_t           begin;  // Timestamp of construction
+    std::uint64_t           packed; // Duration << __SiteBits | site id
+
+    std::uint32_t site()  const { return packed & ((1u << __SiteBits) - 1); }
+    std::uint64_t ticks() const { return packed >> __SiteBits; }
+};
+
+static_assert(sizeof(event) == 16);
+
+struct chunk {
+    event                   data[__Chunk];
+    std::atomic <std::size_t> used {0};
+    std::atomic <chunk *>   next {nullptr};
+};
+
+/**
+ * Events of one thread. Only the owner thread writes, and each event
+ * is published by a release store of the count, so the exporter can
+ * read finished events while the thread keeps recording.
+ * Chunks are kept after trace_clear() and reused.
+ */
+struct buffer {
+    chunk       head;   // First chunk, never freed
+    chunk *     tail;   // Chunk being written
+    std::size_t tid;    // Sequential thread id
+
+    explicit buffer(std::size_t __tid) : tail(&head), tid(__tid) {}
+
+    ~buffer() {
+        auto *__cur = head.next.load();
+        while (__cur != nullptr) {
+            auto *__next = __cur->next.load();
+            delete __cur;
+            __cur = __next;
+        }
+    }
+
+    [[__gnu__::__always_inline__]]
+    void push(const event &__ev) {
+        auto __n = tail->used.load(std::memory_order_relaxed);
+        if (__n == __Chunk) [[unlikely]] {
+            auto *__next = tail->next.load(std::memory_order_relaxed);
+            if (__next == nullptr) {
+                __next = new chunk;
+                tail->next.store(__next, std::memory_order_release);
+            }
+            tail = __next;
+            __n = 0;
+        }
+        tail->data[__n] = __ev;
+        tail->used.store(__n + 1, std::memory_order_release);
+    }
+
+    /* Visit all the published events. */
+    template <class _Fn>
+    void for_each(_Fn &&__fn) const {
+        for (auto *__cur = &head ; __cur != nullptr ;
+             __cur = __cur->next.load(std::memory_order_acquire)) {
+            const auto __n = __cur->used.load(std::memory_order_acquire);
+            for (std::size_t i = 0 ; i != __n ; ++i) __fn(__cur->data[i]);
+        }
+    }
+
+    /* Drop all the events, keeping the chunks. */
+    void clear() {
+        for (auto *__cur = &head ; __cur != nullptr ; __cur = __cur->next.load())
+            __cur->used.store(0, std::memory_order_release);
+        tail = &head;
+    }
+};
+
+/* Owner of all thread buffers, the sites, and the clock calibration. */
+struct registry {
+    std::mutex                              mtx;
+    std::vector <std::unique_ptr <buffer>>  buffers;
+    std::deque <site>                       sites;
+    std::map <std::tuple <const char *, unsigned, unsigned, const char *>, std::uint32_t> index;
+    std::uint64_t                           tick0 = now();
+    std::uint64_t                           nano0 = steady_ns();
+
+    buffer *attach() {
+        std::lock_guard __lock { mtx };
+        buffers.push_back(std::make_unique <buffer> (buffers.size()));
+        return buffers.back().get();
+    }
+
+    /* Return the id of a site, registering it at the first time. */
+    std::uint32_t site_of(const char *__name, std::source_location __loc) {
+        const auto __key = std::tuple {
+            __loc.file_name(), unsigned(__loc.line()), unsigned(__loc.column()), __name
+        };
+        std::lock_guard __lock { mtx };
+        if (const auto __pos = index.find(__key) ; __pos != index.end())
+            return __pos->second;
+        /* Check before inserting, so a throw leaves no index to a missing site. */
+        if (sites.size() >> __SiteBits)
+            throw std::length_error("trace: too many sites");
+        const auto __id = std::uint32_t(sites.size());
+        sites.push_back(site { __loc, __name });
+        index.emplace(__key, __id);
+        return __id;
+    }
+
+    /* Nanoseconds per tick, measured from the first use until now. */
+    double ratio() const {
+        const auto __ticks = now() - tick0;
+        const auto __nanos = steady_ns() - nano0;
+        return __ticks == 0 ? 1.0 : double(__nanos) / double(__ticks);
+    }
+};
+
+/* The registry, leaked on purpose, so spans in static destructors stay safe. */
+inline registry &instance() {
+    static registry *const __inst = new registry;
+    return *__inst;
+}
+
+[[__gnu__::__always_inline__]]
+inline buffer &local_buffer() {
+    thread_local buffer *__buf = instance().attach();
+    return *__buf;
+}
+
+/* Write a JSON string with escapes. */
+inline void write_json(std::ostream &__os, std::string_view __str) {
+    __os << '"';
+    for (const char __c : __str) {
+        switch (__c) {
+            case '"':  __os << "\\\""; break;
+            case '\\': __os << "\\\\"; break;
+            case '\n': __os << "\\n";  break;
+            case '\t': __os << "\\t";  break;
+            default:
+                if (static_cast <unsigned char> (__c) < 0x20) __os << ' ';
+                else __os << __c;
+        }
+    }
+    __os << '"';
+}
+
+inline const char *name_of(const site &__site) {
+    return __site.name != nullptr ? __site.name : __site.loc.function_name();
+}
+
+} // namespace __detail::__trace
+
+
+/**
+ * @brief A RAII trace span, recording the time from construction to
+ * destruction into the buffer of the calling thread.
+ * Use the trace_scope() macro, which looks up the site only once
+ * and compiles out in release mode. Constructing a span by name and
+ * location looks up the site every time, which is much slower.
+ */
+struct trace_span {
+  private:
+    std::uint64_t begin;
+    std::uint32_t site;
+  public:
+    /* Site id of a name and location, for the trace_scope() macro. */
+    static std::uint32_t site_of(const char *__name = nullptr,
+        std::source_location __loc = std::source_location::current()) {
+        return __detail::__trace::instance().site_of(__name, __loc);
+    }
+
+    [[__gnu__::__always_inline__]]
+    explicit trace_span(std::uint32_t __site) noexcept
+        : begin(__detail::__trace::now()), site(__site) {}
+
+    explicit trace_span(const char *__name = nullptr,
+        std::source_location __loc = std::source_location::current())
+        : trace_span(site_of(__name, __loc)) {}
+
+    trace_span(const trace_span &) = delete;
+    trace_span &operator = (const trace_span &) = delete;
+
+    [[__gnu__::__always_inline__]]
+    ~trace_span() {
+        using namespace __detail::__trace;
+        const auto __ticks = std::min(now() - begin, __MaxTicks);
+        local_buffer().push(event { begin, __ticks << __SiteBits | site });
+    }
+};
+
+/* Aggregate all the recorded spans by call site. */
+inline std::vector <trace_site> trace_sites() {
+    using namespace __detail::__trace;
+    auto &__reg = instance();
+    const auto __ratio = __reg.ratio();
+    std::lock_guard __lock { __reg.mtx };
+    std::vector <trace_site> __all;
+    for (const auto &__site : __reg.sites)
+        __all.push_back(trace_site { __site.loc, name_of(__site) });
+    for (const auto &__buf : __reg.buffers) __buf->for_each([&](const event &__ev) {
+        auto &__site = __all[__ev.site()];
+        const auto __ns = std::uint64_t(double(__ev.ticks()) * __ratio);
+        __site.count += 1;
+        __site.total += __ns;
+        __site.min = std::min(__site.min, __ns);
+        __site.max = std::max(__site.max, __ns);
+        __site.histogram[__ns == 0 ? 0 : std::bit_width(__ns) - 1] += 1;
+    });
+    std::vector <trace_site> __ret;
+    for (auto &__site : __all) if (__site.count != 0) __ret.push_back(__site);
+    return __ret;
+}
+
+/* Print a summary line for every call site. */
+inline void trace_summary(std::ostream &__os) {
+    for (const auto &__site : trace_sites()) {
+        __os << std::format("{}:{} {}: count={} total={}ns avg={}ns min={}ns max={}ns\n",
+            __site.loc.file_name(), __site.loc.line(), __site.name, __site.count,
+            __site.total, __site.total / __site.count, __site.min, __site.max);
+    }
+}
+
+/**
+ * @brief Export all the recorded spans in the Chrome trace event format,
+ * which can be loaded by chrome://tracing or Perfetto.
+ */
+inline void trace_export(std::ostream &__os) {
+    using namespace __detail::__trace;
+    auto &__reg = instance();
+    const auto __ratio = __reg.ratio();
+    std::lock_guard __lock { __reg.mtx };
+
+    /* Spans may begin before the registry exists, so find the origin. */
+    auto __origin = __reg.tick0;
+    for (const auto &__buf : __reg.buffers) __buf->for_each([&](const event &__ev) {
+        __origin = std::min(__origin, __ev.begin);
+    });
+
+    bool __first = true;
+    __os << "{\"traceEvents\":[";
+    for (const auto &__buf : __reg.buffers) __buf->for_each([&](const event &__ev) {
+        const auto &__site = __reg.sites[__ev.site()];
+        const auto __ts  = double(__ev.begin - __origin) * __ratio / 1000;
+        const auto __dur = double(__ev.ticks()) * __ratio / 1000;
+        __os << (__first ? "\n" : ",\n");
+        __os << "{\"name\":";
+        write_json(__os, name_of(__site));
+        __os << ",\"cat\":";
+        write_json(__os, std::format("{}:{}", __site.loc.file_name(), __site.loc.line()));
+        __os << std::format(",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":0,\"tid\":{}}}",
+            __ts, __dur, __buf->tid);
+        __first = false;
+    });
+    __os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+/**
+ * @brief Drop all the recorded spans, keeping the memory for reuse.
+ * No span may end on another thread while it runs, so call it
+ * between phases of the program, e.g. after a warm-up.
+ */
+inline void trace_clear() {
+    using namespace __detail::__trace;
+    auto &__reg = instance();
+    std::lock_guard __lock { __reg.mtx };
+    for (const auto &__buf : __reg.buffers) __buf->clear();
+}
+
+} // namespace dark::debug
+
+#define __dark_trace_cat_impl(x,y) x##y
+#define __dark_trace_cat(x,y) __dark_trace_cat_impl(x,y)
+#define __dark_trace_scope(id, ...) \
+    static const std::uint32_t __dark_trace_cat(__dark_trace_site_, id) = \
+        ::dark::debug::trace_span::site_of(__VA_ARGS__); \
+    ::dark::debug::trace_span __dark_trace_cat(__dark_trace_span_, id) { \
+        __dark_trace_cat(__dark_trace_site_, id) }
+
+/**
+ * @brief Trace the rest of the current scope.
+ * An optional name can be given, or the function name is used.
+ * It expands to nothing in release mode, like panic_handler.
+ */
+#define trace_scope(...) __dark_trace_scope(__COUNTER__ __VA_OPT__(,) __VA_ARGS__)
+
+#else // Tracing is turned off.
+
+namespace dark::debug {
+
+/* An empty span, as tracing is turned off. */
+struct trace_span {
+    explicit trace_span(std::uint32_t) noexcept {}
+    explicit trace_span(const char * = nullptr,
+        std::source_location = std::source_location::current()) noexcept {}
+    static std::uint32_t site_of(const char * = nullptr,
+        std::source_location = std::source_location::current()) noexcept { return 0; }
+    trace_span(const trace_span &) = delete;
+    trace_span &operator = (const trace_span &) = delete;
+};
+
+inline std::vector <trace_site> trace_sites() { return {}; }
+inline void trace_summary(std::ostream &) {}
+inline void trace_export(std::ostream &__os) { __os << "{\"traceEvents\":[]}\n"; }
+inline void trace_clear() {}
+
+} // namespace dark::debug
+
+#define trace_scope(...) ((void)0)
+
+#endif